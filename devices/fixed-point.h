@@ -1,35 +1,154 @@
-//该文件为自创文件，无pintos源码，因此不再使用中文注释等作为更改标注
-//UNLESS IT'S TO_INT ,ALL METHODS RETURN FP TYPE OF INT
-//fp、int混合操作函数，开头a均为fp
+#ifndef DEVICES_FIXED_POINT_H
+#define DEVICES_FIXED_POINT_H
 
-#define Q_SHIFT_LEFT 16
-#define HALF_SHIFT 15
-#define AID_Q 1<<16
+/* Fixed-point arithmetic for the MLFQS scheduler.
 
-typedef int fp;
+   A fixed-point number `fp' holds a real number scaled by
+   2**FP_SHIFT.  It is a structure rather than a bare integer so
+   that mixing fixed-point and integer operands is a compile-time
+   error: every operation that takes an integer says so in its
+   name (fp_add_int(), fp_mul_int(), ...).
 
-#define INT_TO_FP(A) ((fp)((A)<<Q_SHIFT_LEFT))
+   By default the value is a 32-bit integer, which gives 15
+   integer bits: enough for load_avg and priorities, but
+   recent_cpu of a CPU-bound thread can approach the limit, and
+   intermediate products such as recent_cpu * 100 exceed it.
+   Define FP_PRECISE to use a 64-bit value instead.  The results
+   that get reported (fp_round_scaled()) are computed in 64 bits
+   either way.
 
-#define FP_TO_INT_ZERO(a) ((int)((a)>>Q_SHIFT_LEFT))
+   Shared with the host-side test in utils/fixed-point-test.c, so
+   this header must depend only on <stdint.h>. */
 
-//	(x + f / 2) / f如果x >= 0，
-//(x - f / 2) / f如果x <= 0。
-#define FP_TO_INT_NEAREST(a) ((int)((a) >= 0 ? ((a) + (1<<HALF_SHIFT))/(AID_Q) : ((a) - (1<<HALF_SHIFT))/(AID_Q)))
+#include <stdint.h>
 
-#define ADD_FP_FP(a,b) ((a) + (b))
+#ifdef FP_PRECISE
+typedef int64_t fp_raw;
+#else
+typedef int32_t fp_raw;
+#endif
 
-#define ADD_FP_INT(a,b) ((a) + (b) * (AID_Q))
+/* A fixed-point number. */
+typedef struct
+{
+  fp_raw raw; /* Value times FP_ONE. */
+} fp;
 
-#define SUB_FP_FP(a,b) ((a) - (b))
+#define FP_SHIFT 16                     /* Fraction bits. */
+#define FP_ONE ((fp_raw)1 << FP_SHIFT)  /* 1.0 as a raw value. */
 
-#define SUB_FP_INT(a,b) ((a) - ((b) * (AID_Q)))
+/* Returns N as a fixed-point number. */
+static inline fp
+fp_from_int(int n)
+{
+  fp x = {(fp_raw)n * FP_ONE};
+  return x;
+}
 
-#define SUB_INT_FP(a,b) (((a)* (AID_Q)) - (b) )
+/* Returns X / D, where X and D are integers, as a fixed-point
+   number.  Useful for constants such as 59/60. */
+static inline fp
+fp_ratio(int x, int d)
+{
+  fp r = {(fp_raw)((int64_t)x * FP_ONE / d)};
+  return r;
+}
 
-#define MULTI_FP(A,B) ((fp)(((int64_t)(A)*(B))/(AID_Q)))
+/* Returns X rounded toward zero. */
+static inline int
+fp_to_int_zero(fp x)
+{
+  return x.raw / FP_ONE;
+}
 
-#define MULTI_FP_INT(A,B) ((A) * (B))
+/* Returns X rounded to the nearest integer. */
+static inline int
+fp_to_int_nearest(fp x)
+{
+  return (x.raw >= 0 ? x.raw + FP_ONE / 2 : x.raw - FP_ONE / 2) / FP_ONE;
+}
 
-#define DIVIDE_FP(A,B) ((fp)(((int64_t)(A)*(AID_Q))/(B)))
+/* Returns X * N rounded to the nearest integer, computed without
+   overflow for any X, e.g. for reporting 100 times load_avg. */
+static inline int
+fp_round_scaled(fp x, int n)
+{
+  int64_t t = (int64_t)x.raw * n;
+  return (t >= 0 ? t + FP_ONE / 2 : t - FP_ONE / 2) / FP_ONE;
+}
 
-#define DIVIDE_FP_INT(A,B) ((A)/(B))
\ No newline at end of file
+/* Returns X + Y. */
+static inline fp
+fp_add(fp x, fp y)
+{
+  fp r = {x.raw + y.raw};
+  return r;
+}
+
+/* Returns X - Y. */
+static inline fp
+fp_sub(fp x, fp y)
+{
+  fp r = {x.raw - y.raw};
+  return r;
+}
+
+/* Returns X + N, where N is an integer. */
+static inline fp
+fp_add_int(fp x, int n)
+{
+  fp r = {x.raw + (fp_raw)n * FP_ONE};
+  return r;
+}
+
+/* Returns X - N, where N is an integer. */
+static inline fp
+fp_sub_int(fp x, int n)
+{
+  fp r = {x.raw - (fp_raw)n * FP_ONE};
+  return r;
+}
+
+/* Returns X * Y. */
+static inline fp
+fp_mul(fp x, fp y)
+{
+  fp r = {(fp_raw)((int64_t)x.raw * y.raw / FP_ONE)};
+  return r;
+}
+
+/* Returns X * N, where N is an integer. */
+static inline fp
+fp_mul_int(fp x, int n)
+{
+  fp r = {x.raw * n};
+  return r;
+}
+
+/* Returns X / Y. */
+static inline fp
+fp_div(fp x, fp y)
+{
+  fp r = {(fp_raw)((int64_t)x.raw * FP_ONE / y.raw)};
+  return r;
+}
+
+/* Returns X / N, where N is an integer. */
+static inline fp
+fp_div_int(fp x, int n)
+{
+  fp r = {x.raw / n};
+  return r;
+}
+
+/* Returns the MLFQS recent_cpu decay coefficient for LOAD_AVG,
+   (2*load_avg) / (2*load_avg + 1).  It is the same for every
+   thread, so compute it once per second, not once per thread. */
+static inline fp
+fp_decay_coef(fp load_avg)
+{
+  fp twice_load = fp_mul_int(load_avg, 2);
+  return fp_div(twice_load, fp_add_int(twice_load, 1));
+}
+
+#endif /* devices/fixed-point.h */
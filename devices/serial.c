@@ -129,6 +129,16 @@ serial_putc (uint8_t byte)
   intr_set_level (old_level);
 }
 
+/* Sends null-terminated string S to the serial port.  Unlike
+   printf(), this bypasses the console lock and the VGA display,
+   so it suits dumping large amounts of raw data. */
+void
+serial_puts (const char *s) 
+{
+  while (*s != '\0')
+    serial_putc (*s++);
+}
+
 /* Flushes anything in the serial buffer out the port in polling
    mode. */
 void
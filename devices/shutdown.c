@@ -4,7 +4,13 @@
 #include "devices/kbd.h"
 #include "devices/serial.h"
 #include "devices/timer.h"
+#include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/lockstat.h"
+#include "threads/palloc.h"
+#include "threads/profile.h"
+#include "threads/schedtrace.h"
+#include "threads/softirq.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/exception.h"
@@ -119,7 +125,13 @@ static void
 print_stats (void)
 {
   timer_print_stats ();
+  intr_print_stats ();
   thread_print_stats ();
+  palloc_print_stats ();
+  lockstat_print_stats ();
+  softirq_print_stats ();
+  schedtrace_dump ();
+  profile_dump ();
 #ifdef FILESYS
   block_print_stats ();
 #endif
@@ -4,7 +4,11 @@
 #include <round.h>
 #include <stdio.h>
 #include "devices/pit.h"
+#include "devices/tsc.h"
 #include "threads/interrupt.h"
+#include "threads/profile.h"
+#include "threads/schedtrace.h"
+#include "threads/softirq.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
 
@@ -17,25 +21,96 @@
 #error TIMER_FREQ <= 1000 recommended
 #endif
 
-/* Number of timer ticks since OS booted. */
+/* Number of timer ticks since OS booted, and the seqlock that
+   lets timer_ticks() read it without turning interrupts off. */
 static int64_t ticks;
+static struct seqlock ticks_seq;
+
+/* Last tick whose MLFQS bookkeeping mlfqs_tick() did, and the
+   number of seconds whose recent_cpu pass timer_softirq() has
+   yet to do. */
+static int64_t mlfqs_ticks;
+static int mlfqs_seconds;
 
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* Number of ticks over which the TSC frequency is measured. */
+#define TSC_CALIBRATE_TICKS 5
+
+/* Tickless idle.
+
+   If true, the periodic tick is stopped while the idle thread
+   runs: timer_idle_enter() puts the PIT in one-shot mode so that
+   it interrupts only at the tick boundary on which the next
+   sleeping thread is due, and the ticks in between are credited
+   in bulk.  Controlled by kernel command-line option
+   "-tickless". */
+bool timer_tickless;
+
+/* PIT cycles in one timer tick. */
+#define TICK_PIT_CYCLES ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Most ticks one PIT one-shot can cover with its 16-bit count. */
+#define TICKLESS_MAX_TICKS (UINT16_MAX / TICK_PIT_CYCLES)
+
+/* Nanoseconds in one timer tick. */
+#define NS_PER_TICK (1000000000 / TIMER_FREQ)
+
+/* Shortest one-shot we program, in PIT cycles (about 4 us). */
+#define ONESHOT_MIN_CYCLES 5
+
+/* Clock events.
+
+   Channel 0 of the PIT normally interrupts periodically, once
+   per tick.  It is switched to one-shot mode to stop the tick in
+   tickless idle and to deliver high-resolution timers that
+   expire between two ticks.  While it is in one-shot mode, the
+   variables below describe what the next timer interrupt is. */
+static bool pit_oneshot;          /* PIT in one-shot mode? */
+static int oneshot_ticks;         /* Ticks the one-shot ends, 0 if between ticks. */
+static int64_t oneshot_expires;   /* When the one-shot fires, in ns. */
+static int64_t next_tick_ns;      /* Next tick boundary, in ns. */
+static int64_t suppressed_ticks;  /* Ticks with no interrupt. */
+
+/* Clocksource: the TSC reading and tick count at calibration,
+   from which timer_now_ns() measures. */
+static uint64_t tsc_base;
+static int64_t tsc_base_ns;
+
+/* High-resolution timers that have been started and not yet
+   expired or cancelled, in a heap ordered by expiry time.
+   Starting or cancelling a timer, or expiring the earliest, takes
+   O(log n) amortized time in the number of pending timers. */
+static struct heap hrtimer_queue;
+
 static intr_handler_func timer_interrupt;
+static softirq_func timer_softirq;
+static void mlfqs_tick(void);
 static bool too_many_loops(unsigned loops);
 static void busy_wait(int64_t loops);
 static void real_time_sleep(int64_t num, int32_t denom);
 static void real_time_delay(int64_t num, int32_t denom);
+static void credit_suppressed_ticks(int64_t);
+static void arm_oneshot(int64_t now, int64_t delay, int tick_cnt);
+static void program_clock_event(bool on_boundary);
+static void program_hrtimer(void);
+static bool hrtimer_less(const struct heap_elem *,
+                         const struct heap_elem *, void *);
+static int64_t hrtimer_next_expiry(void);
+static void hrtimer_sleep(int64_t ns);
 
 /* Sets up the timer to interrupt TIMER_FREQ times per second,
    and registers the corresponding interrupt. */
 void timer_init(void)
 {
+  heap_init(&hrtimer_queue, hrtimer_less, NULL);
+  seqlock_init(&ticks_seq);
+  tsc_init();
   pit_configure_channel(0, 2, TIMER_FREQ);
   intr_register_ext(0x20, timer_interrupt, "8254 Timer");
+  softirq_register(SOFTIRQ_TIMER, timer_softirq);
 }
 
 /* Calibrates loops_per_tick, used to implement brief delays. */
@@ -62,15 +137,58 @@ void timer_calibrate(void)
       loops_per_tick |= test_bit;
 
   printf("%'" PRIu64 " loops/s.\n", (uint64_t)loops_per_tick * TIMER_FREQ);
+
+  /* Measure the TSC against the timer tick so that timer_now_ns()
+     and the high-resolution timers have sub-tick resolution. */
+  if (tsc_present())
+  {
+    int64_t start;
+    uint64_t tsc_start, tsc_end;
+    enum intr_level old_level;
+
+    start = ticks;
+    while (ticks == start)
+      barrier();
+    start = ticks;
+    tsc_start = rdtsc();
+    while (ticks < start + TSC_CALIBRATE_TICKS)
+      barrier();
+    tsc_end = rdtsc();
+
+    old_level = intr_disable();
+    tsc_set_hz((tsc_end - tsc_start) * TIMER_FREQ / TSC_CALIBRATE_TICKS);
+    tsc_base = rdtsc();
+    tsc_base_ns = ticks * NS_PER_TICK;
+    intr_set_level(old_level);
+    printf("TSC clocksource at %'" PRIu64 " kHz.\n", tsc_hz() / 1000);
+  }
+}
+
+/* Returns the number of nanoseconds since the OS booted.  The
+   result is monotonic; it has the resolution of the TSC once
+   timer_calibrate() has measured it, and of the timer tick
+   before that or on CPUs without a TSC. */
+int64_t
+timer_now_ns(void)
+{
+  if (tsc_calibrated())
+    return tsc_base_ns + tsc_to_ns(rdtsc() - tsc_base);
+  else
+    return timer_ticks() * NS_PER_TICK;
 }
 
 /* Returns the number of timer ticks since the OS booted. */
 int64_t
 timer_ticks(void)
 {
-  enum intr_level old_level = intr_disable();
-  int64_t t = ticks;
-  intr_set_level(old_level);
+  unsigned start;
+  int64_t t;
+
+  do
+  {
+    start = seqlock_read_begin(&ticks_seq);
+    t = ticks;
+  } while (seqlock_read_retry(&ticks_seq, start));
   return t;
 }
 
@@ -83,7 +201,8 @@ timer_elapsed(int64_t then)
 }
 
 /* Sleeps for approximately TICKS timer ticks.  Interrupts must
-   be turned on.将定时休眠的线程加入sleep_list */
+   be turned on.将定时休眠的线程加入sleep queue.  The sleep may be
+   ended early by thread_sleep_cancel(). */
 void timer_sleep(int64_t ticks)
 {
   if (ticks <= 0)
@@ -159,34 +278,362 @@ void timer_ndelay(int64_t ns)
   real_time_delay(ns, 1000 * 1000 * 1000);
 }
 
+/* Called by the idle thread, with interrupts off, just before it
+   halts.  In tickless mode, replaces the periodic tick by a
+   single PIT one-shot that fires on the tick boundary when the
+   next sleeping thread or high-resolution timer is due, at most
+   TICKLESS_MAX_TICKS ticks away.  Under the MLFQS the one-shot
+   never crosses a second boundary, so that load_avg is still
+   sampled on time. */
+void timer_idle_enter(void)
+{
+  int64_t delta, hr_expires;
+  uint16_t phase;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  /* Leave the PIT alone if it is already in one-shot mode or if a
+     tick is pending: that interrupt will reprogram it. */
+  if (!timer_tickless || pit_oneshot || intr_ext_pending(0x20))
+    return;
+
+  delta = thread_next_wakeup(ticks, TICKLESS_MAX_TICKS);
+  if (thread_mlfqs && delta > TIMER_FREQ - ticks % TIMER_FREQ)
+    delta = TIMER_FREQ - ticks % TIMER_FREQ;
+  hr_expires = hrtimer_next_expiry();
+  if (hr_expires != INT64_MAX
+      && delta > (hr_expires - timer_now_ns()) / NS_PER_TICK)
+    delta = (hr_expires - timer_now_ns()) / NS_PER_TICK;
+  if (delta <= 1)
+    return;
+
+  /* Keep the tick phase: the first boundary is PHASE cycles away,
+     where the periodic count would have run out. */
+  phase = pit_read_count(0);
+  if (phase == 0 || phase > TICK_PIT_CYCLES)
+    phase = TICK_PIT_CYCLES;
+  pit_configure_oneshot(0, phase + (delta - 1) * TICK_PIT_CYCLES);
+  pit_oneshot = true;
+  oneshot_ticks = delta;
+  oneshot_expires = INT64_MAX;
+}
+
+/* Called from schedule(), with interrupts off, when the idle
+   thread is about to be switched out, and before a
+   high-resolution timer preempts the idle one-shot.  If the idle
+   one-shot is still armed, credits the ticks that have passed so
+   far and shortens the one-shot to end on the next tick
+   boundary, where timer_interrupt() brings back the periodic
+   tick. */
+void timer_idle_exit(void)
+{
+  uint16_t left;
+  int passed;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (!pit_oneshot || oneshot_ticks <= 1)
+    return;
+
+  /* A count beyond the programmed one means the one-shot already
+     wrapped past terminal count and its interrupt is pending. */
+  left = pit_read_count(0);
+  if (left > oneshot_ticks * TICK_PIT_CYCLES || intr_ext_pending(0x20))
+    return;
+
+  /* Boundaries still ahead are at LEFT, LEFT - TICK_PIT_CYCLES,
+     ..., down to 0 cycles from now. */
+  passed = oneshot_ticks - (left / TICK_PIT_CYCLES + 1);
+  credit_suppressed_ticks(passed);
+  left = left % TICK_PIT_CYCLES != 0 ? left % TICK_PIT_CYCLES : 1;
+  pit_configure_oneshot(0, left);
+  oneshot_ticks = 1;
+  oneshot_expires = next_tick_ns
+    = timer_now_ns() + (int64_t)left * 1000000000 / PIT_HZ;
+}
+
+/* Initializes high-resolution timer TIMER to call FUNC, passing
+   TIMER itself, when it expires.  AUX is available to FUNC as
+   TIMER->aux. */
+void hrtimer_init(struct hrtimer *timer, hrtimer_func *func, void *aux)
+{
+  ASSERT(timer != NULL);
+  ASSERT(func != NULL);
+
+  timer->func = func;
+  timer->aux = aux;
+  timer->pending = false;
+}
+
+/* Orders high-resolution timers by expiry time. */
+static bool
+hrtimer_less(const struct heap_elem *a_, const struct heap_elem *b_,
+             void *aux UNUSED)
+{
+  const struct hrtimer *a = heap_entry(a_, struct hrtimer, elem);
+  const struct hrtimer *b = heap_entry(b_, struct hrtimer, elem);
+
+  return a->expires < b->expires;
+}
+
+/* Starts TIMER, which must not be pending, so that its function
+   is called from the timer interrupt once timer_now_ns() reaches
+   EXPIRES.  An expiry time in the past makes it fire at the next
+   opportunity.  May be called from an interrupt handler.
+
+   With a calibrated TSC, a timer that expires before the next
+   tick is delivered by a PIT one-shot with microsecond accuracy;
+   otherwise timers expire on the first tick at or after their
+   expiry time. */
+void hrtimer_start(struct hrtimer *timer, int64_t expires)
+{
+  enum intr_level old_level;
+
+  ASSERT(timer != NULL);
+  ASSERT(!timer->pending);
+
+  old_level = intr_disable();
+  timer->expires = expires;
+  timer->pending = true;
+  heap_insert(&hrtimer_queue, &timer->elem);
+  if (heap_front(&hrtimer_queue) == &timer->elem)
+    program_hrtimer();
+  intr_set_level(old_level);
+}
+
+/* Cancels TIMER.  Returns true if it was pending, false if it
+   had already expired or was never started. */
+bool hrtimer_cancel(struct hrtimer *timer)
+{
+  enum intr_level old_level;
+  bool was_pending;
+
+  ASSERT(timer != NULL);
+
+  old_level = intr_disable();
+  was_pending = timer->pending;
+  if (was_pending)
+  {
+    heap_remove(&hrtimer_queue, &timer->elem);
+    timer->pending = false;
+  }
+  intr_set_level(old_level);
+
+  return was_pending;
+}
+
+/* Returns the expiry time of the earliest pending high-resolution
+   timer, or INT64_MAX if there is none. */
+static int64_t
+hrtimer_next_expiry(void)
+{
+  if (heap_empty(&hrtimer_queue))
+    return INT64_MAX;
+  return heap_entry(heap_front(&hrtimer_queue), struct hrtimer,
+                    elem)->expires;
+}
+
+/* Calls the functions of all high-resolution timers that have
+   expired by NOW. */
+static void
+hrtimer_expire(int64_t now)
+{
+  while (!heap_empty(&hrtimer_queue))
+  {
+    struct hrtimer *timer = heap_entry(heap_front(&hrtimer_queue),
+                                       struct hrtimer, elem);
+    if (timer->expires > now)
+      break;
+    heap_pop_front(&hrtimer_queue);
+    timer->pending = false;
+    timer->func(timer);
+  }
+}
+
+/* Called with interrupts off when the earliest high-resolution
+   timer changes.  If it expires before the timer interrupt that
+   is currently due, switches the PIT to a one-shot for it. */
+static void
+program_hrtimer(void)
+{
+  int64_t now, expires = hrtimer_next_expiry();
+
+  /* Without a calibrated clocksource, timers expire on ticks.
+     If a timer interrupt is already pending, its handler will
+     reprogram the PIT anyway. */
+  if (!tsc_calibrated() || expires == INT64_MAX || intr_ext_pending(0x20))
+    return;
+
+  timer_idle_exit();
+  now = timer_now_ns();
+  if (!pit_oneshot)
+  {
+    /* The periodic count tells how far the next tick is. */
+    next_tick_ns = now + (int64_t)pit_read_count(0) * 1000000000 / PIT_HZ;
+    if (expires < next_tick_ns)
+      arm_oneshot(now, expires - now, 0);
+  }
+  else if (expires < oneshot_expires)
+    arm_oneshot(now, expires - now, 0);
+}
+
+/* Puts the PIT in one-shot mode to interrupt DELAY ns after NOW,
+   an interrupt that ends TICK_CNT timer ticks (0 or 1). */
+static void
+arm_oneshot(int64_t now, int64_t delay, int tick_cnt)
+{
+  int64_t cycles = delay > 0 ? delay * PIT_HZ / 1000000000 : 0;
+
+  if (cycles < ONESHOT_MIN_CYCLES)
+    cycles = ONESHOT_MIN_CYCLES;
+  if (cycles > UINT16_MAX)
+    cycles = UINT16_MAX;
+  pit_configure_oneshot(0, cycles);
+  pit_oneshot = true;
+  oneshot_ticks = tick_cnt;
+  oneshot_expires = now + delay;
+}
+
+/* Decides what the next timer interrupt should be, at the end of
+   timer_interrupt().  ON_BOUNDARY is true if the interrupt just
+   handled ended a tick.  Arms a one-shot for a high-resolution
+   timer due before the next tick boundary, or a one-shot for the
+   boundary itself if we are between ticks; otherwise makes sure
+   the PIT is back in periodic mode, starting a new tick now. */
+static void
+program_clock_event(bool on_boundary)
+{
+  int64_t now = timer_now_ns();
+  int64_t expires = tsc_calibrated() ? hrtimer_next_expiry() : INT64_MAX;
+
+  if (on_boundary)
+    next_tick_ns = now + NS_PER_TICK;
+
+  if (expires < next_tick_ns)
+    arm_oneshot(now, expires - now, 0);
+  else if (!on_boundary)
+    arm_oneshot(now, next_tick_ns - now, 1);
+  else if (pit_oneshot)
+  {
+    pit_configure_channel(0, 2, TIMER_FREQ);
+    pit_oneshot = false;
+  }
+}
+
 /* Prints timer statistics. */
 void timer_print_stats(void)
 {
   printf("Timer: %" PRId64 " ticks\n", timer_ticks());
+  if (timer_tickless)
+    printf("Tickless: %" PRId64 " ticks suppressed while idle\n",
+           suppressed_ticks);
+}
+
+/* Advances the tick count by CNT ticks that passed without a
+   timer interrupt.  Nothing was due on any of them. */
+static void
+credit_suppressed_ticks(int64_t cnt)
+{
+  enum intr_level old_level = seqlock_write_begin(&ticks_seq);
+  ticks += cnt;
+  seqlock_write_end(&ticks_seq, old_level);
+  suppressed_ticks += cnt;
+  thread_tick_suppressed(cnt);
 }
 
 
 //TODO:更改timeInterrupt 实现优先级等定时重计算
 /* Timer interrupt handler. */
 static void
-timer_interrupt(struct intr_frame *args UNUSED)
+timer_interrupt(struct intr_frame *args)
+{
+  bool on_boundary = true;
+
+  /* The end of a one-shot: account for the ticks it covered, if
+     any.  A one-shot for a high-resolution timer between two
+     ticks ends no tick at all. */
+  if (pit_oneshot)
+  {
+    on_boundary = oneshot_ticks > 0;
+    if (oneshot_ticks > 1)
+      credit_suppressed_ticks(oneshot_ticks - 1);
+    oneshot_ticks = 0;
+    oneshot_expires = INT64_MAX;
+  }
+
+  if (on_boundary)
+  {
+    enum intr_level old_level = seqlock_write_begin(&ticks_seq);
+    ticks++;
+    seqlock_write_end(&ticks_seq, old_level);
+    if(thread_mlfqs){
+      // update_recent_cpu_single() 考虑到idle_thread 只能在thread.c中引用，不在timeInterrupt内直接做加法
+      update_recent_cpu_signle();
+      mlfqs_tick();
+    }
+    SCHEDTRACE(TICK, thread_current()->tid, thread_current()->priority, 0);
+    if (profile_enabled)
+      profile_sample(args);
+    wakeup_thread(ticks);
+    thread_tick();
+  }
+
+  hrtimer_expire(timer_now_ns());
+  program_clock_event(on_boundary);
+}
+
+/* Performs the MLFQS bookkeeping that concerns the running
+   thread, for each tick since it last ran: normally just the
+   latest, but after a tickless idle period also the suppressed
+   ticks, during which the idle thread was running.  Each second
+   updates load_avg, counting the running thread, and raises
+   SOFTIRQ_TIMER for the recent_cpu pass over all threads; every
+   fourth tick recomputes the running thread's priority.  This
+   is done here rather than in timer_softirq(), which may run in
+   ksoftirqd, when the running thread is no longer the one that
+   these ticks belong to. */
+static void
+mlfqs_tick(void)
 {
-  ticks++;
-  if(thread_mlfqs){
-    // update_recent_cpu_single() 考虑到idle_thread 只能在thread.c中引用，不在timeInterrupt内直接做加法
-    // update_priority()
-    update_recent_cpu_signle();
+  bool recompute = false;
+
+  while (mlfqs_ticks < ticks)
+  {
+    mlfqs_ticks++;
     //每秒一次，每个线程的recent_cpu 以这种方式更新
-    if(ticks % TIMER_FREQ == 0){
+    if (mlfqs_ticks % TIMER_FREQ == 0)
+    {
       update_load_avg();
-      update_recent_cpu();
-    }
-    else if(ticks % 4 == 0){
-      update_priority_current();
-      // update_priority();
+      mlfqs_seconds++;
+      softirq_raise(SOFTIRQ_TIMER);
     }
+    else if (mlfqs_ticks % 4 == 0)
+      recompute = true;
+  }
+  if (recompute)
+  {
+    update_priority_current();
+    thread_preempt();
   }
-  thread_tick();
+}
+
+/* Timer softirq: decays recent_cpu and recomputes the priority
+   of every thread, once for each second since it last ran.  This
+   does not depend on which thread is running, so it works the
+   same in ksoftirqd.  If it falls more than a second behind, the
+   passes it catches up on all use the latest load_avg. */
+static void
+timer_softirq(void)
+{
+  enum intr_level old_level = intr_disable();
+
+  while (mlfqs_seconds > 0)
+  {
+    mlfqs_seconds--;
+    update_recent_cpu();
+  }
+  intr_set_level(old_level);
+  thread_preempt();
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -235,7 +682,13 @@ real_time_sleep(int64_t num, int32_t denom)
   int64_t ticks = num * TIMER_FREQ / denom;
 
   ASSERT(intr_get_level() == INTR_ON);
-  if (ticks > 0)
+  if (tsc_calibrated())
+  {
+    /* Block on a high-resolution timer, which is accurate to
+       well below one tick. */
+    hrtimer_sleep(num * (1000 * 1000 * 1000 / denom));
+  }
+  else if (ticks > 0)
   {
     /* We're waiting for at least one full timer tick.  Use
          timer_sleep() because it will yield the CPU to other
@@ -250,6 +703,34 @@ real_time_sleep(int64_t num, int32_t denom)
   }
 }
 
+/* Wakes up the thread sleeping on high-resolution timer T. */
+static void
+hrtimer_sleep_expired(struct hrtimer *t)
+{
+  struct thread *sleeper = t->aux;
+
+  thread_unblock(sleeper);
+  thread_preempt();
+}
+
+/* Blocks the running thread for NS nanoseconds. */
+static void
+hrtimer_sleep(int64_t ns)
+{
+  struct hrtimer timer;
+  enum intr_level old_level;
+  int64_t expires = timer_now_ns() + ns;
+
+  if (ns <= 0)
+    return;
+
+  old_level = intr_disable();
+  hrtimer_init(&timer, hrtimer_sleep_expired, thread_current());
+  hrtimer_start(&timer, expires);
+  thread_block(false);
+  intr_set_level(old_level);
+}
+
 /* Busy-wait for approximately NUM/DENOM seconds. */
 static void
 real_time_delay(int64_t num, int32_t denom)
@@ -1,7 +1,10 @@
 #ifndef DEVICES_TIMER_H
 #define DEVICES_TIMER_H
 
+#include <heap.h>
+#include <list.h>
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
@@ -12,6 +15,7 @@ void timer_calibrate (void);
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
+int64_t timer_now_ns (void);
 
 /* Sleep and yield the CPU to other threads. */
 void timer_sleep (int64_t ticks);
@@ -24,6 +28,30 @@ void timer_mdelay (int64_t milliseconds);
 void timer_udelay (int64_t microseconds);
 void timer_ndelay (int64_t nanoseconds);
 
+/* High-resolution timers. */
+struct hrtimer;
+typedef void hrtimer_func (struct hrtimer *);
+
+/* A high-resolution timer: calls FUNC from the timer interrupt
+   once timer_now_ns() reaches EXPIRES. */
+struct hrtimer
+  {
+    struct heap_elem elem;      /* Element in pending timer heap. */
+    int64_t expires;            /* Expiry time, in ns since boot. */
+    hrtimer_func *func;         /* Function to call on expiry. */
+    void *aux;                  /* Auxiliary data for FUNC. */
+    bool pending;               /* Started and not yet expired? */
+  };
+
+void hrtimer_init (struct hrtimer *, hrtimer_func *, void *aux);
+void hrtimer_start (struct hrtimer *, int64_t expires);
+bool hrtimer_cancel (struct hrtimer *);
+
+/* Tickless idle. */
+extern bool timer_tickless;
+void timer_idle_enter (void);
+void timer_idle_exit (void);
+
 void timer_print_stats (void);
 
 #endif /* devices/timer.h */
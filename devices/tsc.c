@@ -0,0 +1,80 @@
+#include "devices/tsc.h"
+#include <debug.h>
+#include "threads/cpuid.h"
+
+/* Time-stamp counter clocksource.
+
+   The TSC counts CPU clock cycles, so it has far better
+   resolution than the 8254 timer tick, but its frequency is not
+   known in advance.  timer_calibrate() measures it against the
+   timer tick and reports it with tsc_set_hz().  Until then, and
+   on CPUs without a TSC, tsc_calibrated() returns false and
+   callers must fall back to timer ticks. */
+
+static bool present;            /* CPU has a TSC? */
+static uint64_t hz;             /* TSC cycles per second, or 0. */
+
+/* Cycles to nanoseconds conversion: ns = cycles * mult >> shift,
+   with MULT chosen to fit in 32 bits. */
+static uint32_t mult;
+static int shift;
+
+/* Detects whether the CPU has a time-stamp counter. */
+void
+tsc_init (void)
+{
+  present = (cpuid_features () & CPUID_EDX_TSC) != 0;
+}
+
+/* Returns true if rdtsc() may be used. */
+bool
+tsc_present (void)
+{
+  return present;
+}
+
+/* Records that the TSC runs at HZ cycles per second, making
+   tsc_to_ns() available. */
+void
+tsc_set_hz (uint64_t new_hz)
+{
+  uint64_t m;
+
+  ASSERT (present);
+  ASSERT (new_hz > 0);
+
+  for (shift = 32; shift > 0; shift--)
+    {
+      m = (1000000000ULL << shift) / new_hz;
+      if (m <= UINT32_MAX)
+        break;
+    }
+  mult = m;
+  hz = new_hz;
+}
+
+/* Returns true if the TSC frequency is known. */
+bool
+tsc_calibrated (void)
+{
+  return hz != 0;
+}
+
+/* Returns the TSC frequency in Hz, or 0 if not yet calibrated. */
+uint64_t
+tsc_hz (void)
+{
+  return hz;
+}
+
+/* Converts CYCLES of the TSC into nanoseconds.  The TSC must have
+   been calibrated. */
+uint64_t
+tsc_to_ns (uint64_t cycles)
+{
+  uint64_t hi = cycles >> 32;
+  uint64_t lo = cycles & UINT32_MAX;
+
+  ASSERT (hz != 0);
+  return ((hi * mult) << (32 - shift)) + ((lo * mult) >> shift);
+}
@@ -0,0 +1,25 @@
+#ifndef DEVICES_TSC_H
+#define DEVICES_TSC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Reads the processor's time-stamp counter, which counts clock
+   cycles since reset.  Only valid if tsc_present().
+   See [IA32-v2b] "RDTSC". */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+void tsc_init (void);
+bool tsc_present (void);
+void tsc_set_hz (uint64_t hz);
+bool tsc_calibrated (void);
+uint64_t tsc_hz (void);
+uint64_t tsc_to_ns (uint64_t cycles);
+
+#endif /* devices/tsc.h */
@@ -0,0 +1,165 @@
+#include "heap.h"
+#include "../debug.h"
+
+static struct heap_elem *link (struct heap *,
+                               struct heap_elem *, struct heap_elem *);
+static struct heap_elem *merge_pairs (struct heap *, struct heap_elem *);
+
+/* Initializes HEAP as an empty heap ordered by LESS, given
+   auxiliary data AUX. */
+void
+heap_init (struct heap *heap, heap_less_func *less, void *aux)
+{
+  ASSERT (heap != NULL);
+  ASSERT (less != NULL);
+
+  heap->root = NULL;
+  heap->size = 0;
+  heap->less = less;
+  heap->aux = aux;
+}
+
+/* Inserts ELEM into HEAP. */
+void
+heap_insert (struct heap *heap, struct heap_elem *elem)
+{
+  ASSERT (heap != NULL);
+  ASSERT (elem != NULL);
+
+  elem->child = elem->next = elem->prev = NULL;
+  heap->root = link (heap, heap->root, elem);
+  heap->size++;
+}
+
+/* Returns the front element of HEAP, that is, an element that
+   no other element is less than.  Undefined behavior if HEAP is
+   empty. */
+struct heap_elem *
+heap_front (const struct heap *heap)
+{
+  ASSERT (!heap_empty (heap));
+  return heap->root;
+}
+
+/* Removes the front element of HEAP and returns it.  Undefined
+   behavior if HEAP is empty. */
+struct heap_elem *
+heap_pop_front (struct heap *heap)
+{
+  struct heap_elem *front = heap_front (heap);
+
+  heap->root = merge_pairs (heap, front->child);
+  heap->size--;
+  return front;
+}
+
+/* Removes ELEM, which must be in HEAP, from HEAP. */
+void
+heap_remove (struct heap *heap, struct heap_elem *elem)
+{
+  ASSERT (heap != NULL);
+  ASSERT (elem != NULL);
+
+  if (elem == heap->root)
+    {
+      heap_pop_front (heap);
+      return;
+    }
+
+  /* Cut ELEM's subtree out of the tree, then merge its children
+     back in at the root. */
+  if (elem->prev->child == elem)
+    elem->prev->child = elem->next;
+  else
+    elem->prev->next = elem->next;
+  if (elem->next != NULL)
+    elem->next->prev = elem->prev;
+  heap->root = link (heap, heap->root, merge_pairs (heap, elem->child));
+  heap->size--;
+}
+
+/* Restores HEAP's ordering after the key of ELEM, which must be
+   in HEAP, has changed. */
+void
+heap_update (struct heap *heap, struct heap_elem *elem)
+{
+  heap_remove (heap, elem);
+  heap_insert (heap, elem);
+}
+
+/* Returns the number of elements in HEAP. */
+size_t
+heap_size (const struct heap *heap)
+{
+  ASSERT (heap != NULL);
+  return heap->size;
+}
+
+/* Returns true if HEAP is empty, false otherwise. */
+bool
+heap_empty (const struct heap *heap)
+{
+  ASSERT (heap != NULL);
+  return heap->root == NULL;
+}
+
+/* Links trees A and B, either of which may be null, whose roots
+   have no siblings, and returns the root of the result. */
+static struct heap_elem *
+link (struct heap *heap, struct heap_elem *a, struct heap_elem *b)
+{
+  if (a == NULL)
+    return b;
+  if (b == NULL)
+    return a;
+  if (heap->less (b, a, heap->aux))
+    {
+      struct heap_elem *t = a;
+      a = b;
+      b = t;
+    }
+
+  /* B becomes A's first child. */
+  b->prev = a;
+  b->next = a->child;
+  if (a->child != NULL)
+    a->child->prev = b;
+  a->child = b;
+  return a;
+}
+
+/* Merges the sibling list that begins at FIRST into a single
+   tree and returns its root, or a null pointer if FIRST is null.
+   This is the standard two-pass merge: siblings are linked in
+   pairs from left to right, then the pairs are linked from right
+   to left. */
+static struct heap_elem *
+merge_pairs (struct heap *heap, struct heap_elem *first)
+{
+  struct heap_elem *pairs = NULL;
+  struct heap_elem *root = NULL;
+
+  while (first != NULL)
+    {
+      struct heap_elem *a = first;
+      struct heap_elem *b = a->next;
+
+      first = b != NULL ? b->next : NULL;
+      a->next = a->prev = NULL;
+      if (b != NULL)
+        b->next = b->prev = NULL;
+      a = link (heap, a, b);
+      a->next = pairs;
+      pairs = a;
+    }
+
+  while (pairs != NULL)
+    {
+      struct heap_elem *next = pairs->next;
+
+      pairs->next = NULL;
+      root = link (heap, root, pairs);
+      pairs = next;
+    }
+  return root;
+}
@@ -0,0 +1,70 @@
+#ifndef __LIB_KERNEL_HEAP_H
+#define __LIB_KERNEL_HEAP_H
+
+/* Priority queue.
+
+   This is a pairing heap: a heap-ordered multiway tree in which
+   each node points to its first child and to its siblings.
+   Insertion and merging take constant time, and removing the
+   front element or an arbitrary element takes O(log n) amortized
+   time.  See Fredman, Sedgewick, Sleator, and Tarjan, "The
+   pairing heap: a new form of self-adjusting heap" (1986).
+
+   Like the doubly linked list in list.h, the heap does no
+   dynamic allocation.  Each structure that can be in a heap
+   embeds a struct heap_elem member, and heap_entry() converts a
+   heap element back into the structure that contains it.
+
+   The heap is ordered by a heap_less_func supplied to
+   heap_init(): the front of the heap is an element that no other
+   element is "less" than.  To keep elements with equal keys in
+   FIFO order, break ties in the comparison function, e.g. by an
+   insertion sequence number. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Heap element. */
+struct heap_elem
+  {
+    struct heap_elem *child;    /* First child. */
+    struct heap_elem *next;     /* Next sibling. */
+    struct heap_elem *prev;     /* Previous sibling, or parent. */
+  };
+
+/* Converts pointer to heap element HEAP_ELEM into a pointer to
+   the structure that HEAP_ELEM is embedded inside.  Supply the
+   name of the outer structure STRUCT and the member name MEMBER
+   of the heap element. */
+#define heap_entry(HEAP_ELEM, STRUCT, MEMBER)           \
+        ((STRUCT *) ((uint8_t *) (HEAP_ELEM)            \
+                     - offsetof (STRUCT, MEMBER)))
+
+/* Compares the value of two heap elements A and B, given
+   auxiliary data AUX.  Returns true if A belongs before B. */
+typedef bool heap_less_func (const struct heap_elem *a,
+                             const struct heap_elem *b,
+                             void *aux);
+
+/* Heap. */
+struct heap
+  {
+    struct heap_elem *root;     /* Front element, or null if empty. */
+    size_t size;                /* Number of elements. */
+    heap_less_func *less;       /* Comparison function. */
+    void *aux;                  /* Auxiliary data for `less'. */
+  };
+
+void heap_init (struct heap *, heap_less_func *, void *aux);
+
+void heap_insert (struct heap *, struct heap_elem *);
+struct heap_elem *heap_front (const struct heap *);
+struct heap_elem *heap_pop_front (struct heap *);
+void heap_remove (struct heap *, struct heap_elem *);
+void heap_update (struct heap *, struct heap_elem *);
+
+size_t heap_size (const struct heap *);
+bool heap_empty (const struct heap *);
+
+#endif /* lib/kernel/heap.h */
@@ -0,0 +1,77 @@
+/* Checks sub-tick sleeps with timer_usleep() and timer_nsleep():
+   the sleeping thread must block, letting a lower-priority
+   thread run, and wake no earlier than asked and no more than a
+   timer tick late. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+#include "devices/tsc.h"
+
+#define SLEEP_CNT 5
+
+/* Latest a sleep may end, past its requested length. */
+#define SLACK_NS (1000000000 / TIMER_FREQ)
+
+static thread_func spinner;
+static void check_sleeps (const char *name, int64_t ns, bool use_nsleep);
+
+static volatile unsigned spins;
+static volatile bool done;
+
+void
+test_alarm_usleep (void) 
+{
+  ASSERT (!thread_mlfqs);
+
+  if (!tsc_calibrated ())
+    fail ("sub-tick sleeps need a calibrated TSC.");
+
+  thread_create ("spinner", PRI_DEFAULT - 1, spinner, NULL);
+  check_sleeps ("timer_usleep(2000)", 2000 * 1000, false);
+  check_sleeps ("timer_nsleep(500000)", 500 * 1000, true);
+
+  /* Let the spinner see that it is done. */
+  done = true;
+  timer_sleep (2);
+}
+
+/* Sleeps SLEEP_CNT times for NS nanoseconds, with timer_nsleep()
+   if USE_NSLEEP is true or timer_usleep() otherwise, and reports
+   whether every sleep blocked and woke on time. */
+static void
+check_sleeps (const char *name, int64_t ns, bool use_nsleep) 
+{
+  bool blocked = true, on_time = true;
+  int i;
+
+  for (i = 0; i < SLEEP_CNT; i++)
+    {
+      unsigned start_spins = spins;
+      int64_t start = timer_now_ns ();
+      int64_t elapsed;
+
+      if (use_nsleep)
+        timer_nsleep (ns);
+      else
+        timer_usleep (ns / 1000);
+      elapsed = timer_now_ns () - start;
+
+      if (spins == start_spins)
+        blocked = false;
+      if (elapsed < ns || elapsed > ns + SLACK_NS)
+        on_time = false;
+    }
+  msg ("%s blocked: %s.", name, blocked ? "yes" : "no");
+  msg ("%s woke on time: %s.", name, on_time ? "yes" : "no");
+}
+
+/* Runs whenever the main thread sleeps, counting spins. */
+static void
+spinner (void *aux UNUSED) 
+{
+  while (!done)
+    spins++;
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOT']);
+(alarm-usleep) begin
+(alarm-usleep) timer_usleep(2000) blocked: yes.
+(alarm-usleep) timer_usleep(2000) woke on time: yes.
+(alarm-usleep) timer_nsleep(500000) blocked: yes.
+(alarm-usleep) timer_nsleep(500000) woke on time: yes.
+(alarm-usleep) end
+EOT
+pass;
@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::threads::mlfqs;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+my (@actual);
+local ($_);
+foreach (@output) {
+    my ($id, $count) = /Thread (\d+) received (\d+) ticks\./ or next;
+    $actual[$id] = $count;
+}
+
+# Shares of 3000 ticks for weights 1024 (nice 0) and 335 (nice 5).
+my (@expected) = (2260, 740);
+mlfqs_compare ("thread", "%d", \@actual, \@expected, 50, [0, 1, 1],
+	       "Some tick counts were missing or differed from those "
+	       . "expected by more than 50.");
+pass;
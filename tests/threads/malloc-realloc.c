@@ -0,0 +1,136 @@
+/* Checks that realloc() resizes in place where it can: a block
+   whose size class still fits stays put, a multi-page block grows
+   into free pages that follow it, even ones in the middle of a
+   larger free block, and moves when the page after it is in use,
+   and shrinking a multi-page block gives its tail pages back.
+
+   To control which pages are free, the test takes every free
+   page in the kernel pool, then frees two 8-page runs that it
+   set aside, so that those are the only free memory. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+#define RUN_PAGES 8
+
+/* Size of a malloc() block spanning N pages. */
+#define PAGES(N) ((N) * PGSIZE - 64)
+
+static void *alloc_all (size_t *page_cnt);
+static void free_all (void *pages);
+static size_t count_free (void);
+static bool check_pattern (const uint8_t *, size_t);
+
+void
+test_malloc_realloc (void) 
+{
+  uint8_t *p, *q, *run, *spare, *neighbor;
+  void *rest;
+  size_t rest_cnt, free_before, free_after;
+
+  p = malloc (100);
+  memset (p, 0x5a, 100);
+  q = realloc (p, 120);
+  msg ("Same-class realloc kept the block: %s.",
+       q == p && check_pattern (q, 100) ? "yes" : "no");
+  free (q);
+
+  spare = palloc_get_multiple (0, RUN_PAGES);
+  run = palloc_get_multiple (0, RUN_PAGES);
+  if (spare == NULL || run == NULL)
+    fail ("could not set aside two %d-page runs.", RUN_PAGES);
+  rest = alloc_all (&rest_cnt);
+  palloc_free_multiple (spare, RUN_PAGES);
+  palloc_free_multiple (run, RUN_PAGES);
+
+  /* RUN was freed last, so it is split first: P gets its first
+     2 pages, and pages 2-3 and 4-7 stay free. */
+  p = malloc (PAGES (2));
+  memset (p, 0x5a, PAGES (2));
+  q = realloc (p, PAGES (4));
+  msg ("Grew into the free pages that follow: %s.",
+       q == p && check_pattern (q, PAGES (2)) ? "yes" : "no");
+
+  /* Pages 4-5 come out of the free block of pages 4-7. */
+  p = q;
+  q = realloc (p, PAGES (6));
+  msg ("Grew into part of a larger free block: %s.",
+       q == p && check_pattern (q, PAGES (2)) ? "yes" : "no");
+
+  /* Page 6 is now in use, so growing further must move. */
+  neighbor = palloc_get_page (0);
+  p = q;
+  q = realloc (p, PAGES (7));
+  msg ("Moved when the next page was in use: %s.",
+       q != NULL && q != p && check_pattern (q, PAGES (2)) ? "yes" : "no");
+  palloc_free_page (neighbor);
+
+  free_before = count_free ();
+  p = q;
+  q = realloc (p, PAGES (3));
+  free_after = count_free ();
+  msg ("Shrinking kept the block: %s.", q == p ? "yes" : "no");
+  msg ("Shrinking from 7 to 3 pages freed %d pages.",
+       (int) (free_after - free_before));
+  free (q);
+
+  free_all (rest);
+}
+
+/* Allocates every free kernel page, storing their number in
+   *PAGE_CNT.  Returns the pages, linked through their first
+   words. */
+static void *
+alloc_all (size_t *page_cnt) 
+{
+  void *head = NULL;
+  void **page;
+
+  *page_cnt = 0;
+  while ((page = palloc_get_page (0)) != NULL)
+    {
+      *page = head;
+      head = page;
+      ++*page_cnt;
+    }
+  return head;
+}
+
+/* Frees the pages returned by alloc_all(). */
+static void
+free_all (void *pages) 
+{
+  while (pages != NULL)
+    {
+      void *next = *(void **) pages;
+      palloc_free_page (pages);
+      pages = next;
+    }
+}
+
+/* Returns the number of free kernel pages. */
+static size_t
+count_free (void) 
+{
+  size_t cnt;
+
+  free_all (alloc_all (&cnt));
+  return cnt;
+}
+
+/* Returns true if the SIZE bytes at P all still hold 0x5a. */
+static bool
+check_pattern (const uint8_t *p, size_t size) 
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    if (p[i] != 0x5a)
+      return false;
+  return true;
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOT']);
+(malloc-realloc) begin
+(malloc-realloc) Same-class realloc kept the block: yes.
+(malloc-realloc) Grew into the free pages that follow: yes.
+(malloc-realloc) Grew into part of a larger free block: yes.
+(malloc-realloc) Moved when the next page was in use: yes.
+(malloc-realloc) Shrinking kept the block: yes.
+(malloc-realloc) Shrinking from 7 to 3 pages freed 4 pages.
+(malloc-realloc) end
+EOT
+pass;
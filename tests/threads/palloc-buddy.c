@@ -0,0 +1,90 @@
+/* Checks the buddy page allocator: pages freed one at a time
+   merge back into large contiguous runs, runs that are not a
+   power of two in length leak no pages, and PAL_ZERO pages are
+   zeroed. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+#define RUN_PAGES 16
+
+static void *alloc_all (size_t page_cnt, size_t *run_cnt);
+static void free_all (void *runs, size_t page_cnt);
+
+void
+test_palloc_buddy (void) 
+{
+  size_t single_cnt, run_cnt, again_cnt;
+  uint8_t *run;
+  void *pages;
+  size_t i;
+  bool zeroed;
+
+  /* Take every free page in the kernel pool one at a time, then
+     give them all back.  Only merged buddies can satisfy a large
+     request afterward. */
+  pages = alloc_all (1, &single_cnt);
+  if (single_cnt < RUN_PAGES)
+    fail ("only %zu pages in the kernel pool.", single_cnt);
+  msg ("Allocated every free page one at a time.");
+  free_all (pages, 1);
+
+  run = palloc_get_multiple (0, RUN_PAGES);
+  msg ("Freed pages merged into a %d-page run: %s.",
+       RUN_PAGES, run != NULL ? "yes" : "no");
+  palloc_free_multiple (run, RUN_PAGES);
+
+  /* 3-page runs are carved from 4-page blocks; the fourth page
+     must go back to the free lists. */
+  pages = alloc_all (3, &run_cnt);
+  free_all (pages, 3);
+  pages = alloc_all (1, &again_cnt);
+  free_all (pages, 1);
+  msg ("Pages allocatable after 3-page runs were freed: %s.",
+       again_cnt == single_cnt ? "all" : "fewer");
+
+  run = palloc_get_multiple (0, 5);
+  memset (run, 0xaa, 5 * PGSIZE);
+  palloc_free_multiple (run, 5);
+  run = palloc_get_multiple (PAL_ZERO, 5);
+  zeroed = run != NULL;
+  for (i = 0; zeroed && i < 5 * PGSIZE; i++)
+    zeroed = run[i] == 0;
+  palloc_free_multiple (run, 5);
+  msg ("PAL_ZERO pages are zeroed: %s.", zeroed ? "yes" : "no");
+}
+
+/* Allocates runs of PAGE_CNT kernel pages until none is left,
+   storing the number of runs in *RUN_CNT.  Returns the runs,
+   linked through their first words. */
+static void *
+alloc_all (size_t page_cnt, size_t *run_cnt) 
+{
+  void *head = NULL;
+  void **run;
+
+  *run_cnt = 0;
+  while ((run = palloc_get_multiple (0, page_cnt)) != NULL)
+    {
+      *run = head;
+      head = run;
+      ++*run_cnt;
+    }
+  return head;
+}
+
+/* Frees the runs of PAGE_CNT pages returned by alloc_all(). */
+static void
+free_all (void *runs, size_t page_cnt) 
+{
+  while (runs != NULL)
+    {
+      void *next = *(void **) runs;
+      palloc_free_multiple (runs, page_cnt);
+      runs = next;
+    }
+}
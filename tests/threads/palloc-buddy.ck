@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOT']);
+(palloc-buddy) begin
+(palloc-buddy) Allocated every free page one at a time.
+(palloc-buddy) Freed pages merged into a 16-page run: yes.
+(palloc-buddy) Pages allocatable after 3-page runs were freed: all.
+(palloc-buddy) PAL_ZERO pages are zeroed: yes.
+(palloc-buddy) end
+EOT
+pass;
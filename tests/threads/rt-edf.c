@@ -0,0 +1,78 @@
+/* Checks the real-time scheduling class.
+
+   A real-time thread with a budget of 6 ticks every 10 ticks
+   and an ordinary thread both spin for 200 ticks.  The
+   real-time thread always runs first but is throttled once its
+   budget runs out, so it should receive about 120 ticks and
+   the ordinary thread about 80.
+
+   Admission control should reject a second real-time thread
+   that would push the total utilization to 100%, and admit it
+   once the first thread has exited. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+struct thread_info 
+  {
+    int64_t start_time;
+    int tick_count;
+  };
+
+static thread_func load_thread;
+static thread_func noop_thread;
+
+void
+test_rt_edf (void) 
+{
+  struct thread_info rt_info, load_info;
+  int64_t start_time;
+
+  ASSERT (!thread_mlfqs);
+
+  start_time = timer_ticks ();
+  rt_info.start_time = load_info.start_time = start_time;
+  rt_info.tick_count = load_info.tick_count = 0;
+  thread_create ("load", PRI_DEFAULT, load_thread, &load_info);
+  if (thread_create_rt ("rt 60%", 10, 6, load_thread, &rt_info) == TID_ERROR)
+    fail ("thread_create_rt() rejected the first real-time thread.");
+
+  msg ("Second real-time thread %s.",
+       thread_create_rt ("rt 40%", 10, 4, noop_thread, NULL) == TID_ERROR
+       ? "rejected" : "admitted");
+
+  timer_sleep (250);
+  msg ("Real-time thread received %d ticks.", rt_info.tick_count);
+  msg ("Ordinary thread received %d ticks.", load_info.tick_count);
+
+  msg ("After exit, second real-time thread %s.",
+       thread_create_rt ("rt 40%", 10, 4, noop_thread, NULL) == TID_ERROR
+       ? "rejected" : "admitted");
+}
+
+static void
+load_thread (void *ti_) 
+{
+  struct thread_info *ti = ti_;
+  int64_t sleep_time = 20;
+  int64_t spin_time = sleep_time + 200;
+  int64_t last_time = 0;
+
+  timer_sleep (sleep_time - timer_elapsed (ti->start_time));
+  while (timer_elapsed (ti->start_time) < spin_time) 
+    {
+      int64_t cur_time = timer_ticks ();
+      if (cur_time != last_time)
+        ti->tick_count++;
+      last_time = cur_time;
+    }
+}
+
+static void
+noop_thread (void *aux UNUSED) 
+{
+}
@@ -0,0 +1,31 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::threads::mlfqs;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+my (%seen);
+my (@actual);
+local ($_);
+foreach (@output) {
+    $seen{$1} = $2 if /^\(rt-edf\) (.*) thread (rejected|admitted)\./;
+    $actual[0] = $1 if /Real-time thread received (\d+) ticks\./;
+    $actual[1] = $1 if /Ordinary thread received (\d+) ticks\./;
+}
+
+fail "Second real-time thread was not rejected.\n"
+  if ($seen{"Second real-time"} // '') ne 'rejected';
+fail "Second real-time thread was not admitted after the first exited.\n"
+  if ($seen{"After exit, second real-time"} // '') ne 'admitted';
+
+# 200 ticks split 6:4 between the real-time and ordinary threads.
+my (@expected) = (120, 80);
+mlfqs_compare ("thread", "%d", \@actual, \@expected, 10, [0, 1, 1],
+	       "Some tick counts were missing or differed from those "
+	       . "expected by more than 10.");
+pass;
@@ -0,0 +1,58 @@
+/* The main thread acquires a read-preferring rwlock for reading.
+   A writer then blocks waiting for the main thread to release
+   it, but a higher-priority reader that comes along afterward
+   still gets the lock for reading at once.  Once the main
+   thread releases its read lock, the writer acquires the lock. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func reader_thread_func;
+static thread_func writer_thread_func;
+
+void
+test_rwlock_share (void) 
+{
+  struct rwlock rwlock;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rwlock, false);
+  rwlock_acquire_read (&rwlock);
+  msg ("Main thread acquired read lock.");
+  thread_create ("writer", PRI_DEFAULT + 1, writer_thread_func, &rwlock);
+  msg ("Writer is waiting for the readers.");
+  thread_create ("reader", PRI_DEFAULT + 2, reader_thread_func, &rwlock);
+  msg ("Main thread releasing read lock.");
+  rwlock_release_read (&rwlock);
+  msg ("Main thread finished.");
+}
+
+static void
+reader_thread_func (void *rwlock_) 
+{
+  struct rwlock *rwlock = rwlock_;
+
+  rwlock_acquire_read (rwlock);
+  msg ("Reader acquired read lock.");
+  rwlock_release_read (rwlock);
+  msg ("Reader finished.");
+}
+
+static void
+writer_thread_func (void *rwlock_) 
+{
+  struct rwlock *rwlock = rwlock_;
+
+  rwlock_acquire_write (rwlock);
+  msg ("Writer acquired write lock.");
+  rwlock_release_write (rwlock);
+  msg ("Writer finished.");
+}
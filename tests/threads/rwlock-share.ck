@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-share) begin
+(rwlock-share) Main thread acquired read lock.
+(rwlock-share) Writer is waiting for the readers.
+(rwlock-share) Reader acquired read lock.
+(rwlock-share) Reader finished.
+(rwlock-share) Main thread releasing read lock.
+(rwlock-share) Writer acquired write lock.
+(rwlock-share) Writer finished.
+(rwlock-share) Main thread finished.
+(rwlock-share) end
+EOF
+pass;
@@ -0,0 +1,62 @@
+/* The main thread acquires a write-preferring rwlock for
+   reading.  A writer then blocks waiting for the main thread to
+   release it, and a higher-priority reader that comes along
+   afterward must wait behind the writer, donating its priority
+   to the writer.  Once the main thread releases its read lock,
+   the writer runs at the reader's priority, and the reader gets
+   the lock as soon as the writer releases it. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func reader_thread_func;
+static thread_func writer_thread_func;
+
+void
+test_rwlock_writer (void) 
+{
+  struct rwlock rwlock;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rwlock, true);
+  rwlock_acquire_read (&rwlock);
+  msg ("Main thread acquired read lock.");
+  thread_create ("writer", PRI_DEFAULT + 1, writer_thread_func, &rwlock);
+  msg ("Writer is waiting for the readers.");
+  thread_create ("reader", PRI_DEFAULT + 2, reader_thread_func, &rwlock);
+  msg ("Reader is waiting for the writer.");
+  msg ("Main thread releasing read lock.");
+  rwlock_release_read (&rwlock);
+  msg ("Main thread finished.");
+}
+
+static void
+reader_thread_func (void *rwlock_) 
+{
+  struct rwlock *rwlock = rwlock_;
+
+  rwlock_acquire_read (rwlock);
+  msg ("Reader acquired read lock.");
+  rwlock_release_read (rwlock);
+  msg ("Reader finished.");
+}
+
+static void
+writer_thread_func (void *rwlock_) 
+{
+  struct rwlock *rwlock = rwlock_;
+
+  rwlock_acquire_write (rwlock);
+  msg ("Writer acquired write lock with priority %d.",
+       thread_get_priority ());
+  rwlock_release_write (rwlock);
+  msg ("Writer finished with priority %d.", thread_get_priority ());
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-writer) begin
+(rwlock-writer) Main thread acquired read lock.
+(rwlock-writer) Writer is waiting for the readers.
+(rwlock-writer) Reader is waiting for the writer.
+(rwlock-writer) Main thread releasing read lock.
+(rwlock-writer) Writer acquired write lock with priority 33.
+(rwlock-writer) Reader acquired read lock.
+(rwlock-writer) Reader finished.
+(rwlock-writer) Writer finished with priority 32.
+(rwlock-writer) Main thread finished.
+(rwlock-writer) end
+EOF
+pass;
@@ -0,0 +1,77 @@
+/* Checks that a seqlock reader notices a write that overlaps it,
+   then has a higher-priority thread update a pair of 64-bit
+   counters under a seqlock once per tick while the main thread
+   keeps reading them, and verifies that the main thread never
+   sees the two counters differ. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Number of updates made by the writer. */
+#define WRITE_CNT 20
+
+static struct seqlock seqlock;
+static int64_t first, second;
+static volatile bool writer_done;
+
+static thread_func writer_thread_func;
+
+void
+test_seqlock (void) 
+{
+  enum intr_level old_level;
+  unsigned start;
+  int torn_cnt;
+
+  seqlock_init (&seqlock);
+
+  start = seqlock_read_begin (&seqlock);
+  msg ("Retry without a write: %s.",
+       seqlock_read_retry (&seqlock, start) ? "yes" : "no");
+  old_level = seqlock_write_begin (&seqlock);
+  first = second = 1;
+  seqlock_write_end (&seqlock, old_level);
+  msg ("Retry after a write: %s.",
+       seqlock_read_retry (&seqlock, start) ? "yes" : "no");
+
+  thread_create ("writer", PRI_DEFAULT + 1, writer_thread_func, NULL);
+  torn_cnt = 0;
+  while (!writer_done) 
+    {
+      int64_t a, b;
+
+      do
+        {
+          start = seqlock_read_begin (&seqlock);
+          a = first;
+          b = second;
+        }
+      while (seqlock_read_retry (&seqlock, start));
+      if (a != b)
+        torn_cnt++;
+    }
+  msg ("Torn reads: %d.", torn_cnt);
+  msg ("Final value: %lld.", first);
+}
+
+static void
+writer_thread_func (void *aux UNUSED) 
+{
+  int64_t i;
+
+  for (i = 0; i < WRITE_CNT; i++) 
+    {
+      enum intr_level old_level;
+
+      timer_sleep (1);
+      old_level = seqlock_write_begin (&seqlock);
+      first = ((int64_t) i << 32) + i;
+      second = first;
+      seqlock_write_end (&seqlock, old_level);
+    }
+  writer_done = true;
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(seqlock) begin
+(seqlock) Retry without a write: no.
+(seqlock) Retry after a write: yes.
+(seqlock) Torn reads: 0.
+(seqlock) Final value: 81604378643.
+(seqlock) end
+EOF
+pass;
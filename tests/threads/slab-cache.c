@@ -0,0 +1,72 @@
+/* Checks object caches: objects are aligned and distinct, the
+   constructor runs once per object rather than once per
+   allocation, and freed objects are reused. */
+
+#include <stdio.h>
+#include <stdint.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/slab.h"
+
+#define OBJ_CNT 100
+#define OBJ_SIZE 40
+#define OBJ_ALIGN 8
+
+struct obj
+  {
+    int ctor_cnt;
+    char data[OBJ_SIZE - sizeof (int)];
+  };
+
+static kmem_ctor obj_ctor;
+static int ctor_calls;
+
+void
+test_slab_cache (void) 
+{
+  struct kmem_cache *cache;
+  struct obj *objs[OBJ_CNT];
+  struct obj *again;
+  bool aligned = true, distinct = true, constructed = true;
+  int calls;
+  int i, j;
+
+  cache = kmem_cache_create ("test", sizeof (struct obj), OBJ_ALIGN,
+                             obj_ctor);
+  if (cache == NULL)
+    fail ("kmem_cache_create() failed.");
+
+  for (i = 0; i < OBJ_CNT; i++)
+    {
+      objs[i] = kmem_cache_alloc (cache);
+      if (objs[i] == NULL)
+        fail ("kmem_cache_alloc() failed.");
+      aligned = aligned && (uintptr_t) objs[i] % OBJ_ALIGN == 0;
+      constructed = constructed && objs[i]->ctor_cnt == 1;
+      for (j = 0; j < i; j++)
+        distinct = distinct && objs[i] != objs[j];
+    }
+  msg ("Objects aligned: %s.", aligned ? "yes" : "no");
+  msg ("Objects distinct: %s.", distinct ? "yes" : "no");
+  msg ("Objects constructed: %s.", constructed ? "yes" : "no");
+
+  calls = ctor_calls;
+  kmem_cache_free (cache, objs[OBJ_CNT / 2]);
+  again = kmem_cache_alloc (cache);
+  msg ("Freed object reused: %s.",
+       again == objs[OBJ_CNT / 2] ? "yes" : "no");
+  msg ("Constructor ran again on reuse: %s.",
+       ctor_calls != calls || again->ctor_cnt != 1 ? "yes" : "no");
+
+  for (i = 0; i < OBJ_CNT; i++)
+    kmem_cache_free (cache, objs[i]);
+}
+
+/* Constructor: counts the times it has run on object O_. */
+static void
+obj_ctor (void *o_) 
+{
+  struct obj *o = o_;
+  o->ctor_cnt = 1;
+  ctor_calls++;
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOT']);
+(slab-cache) begin
+(slab-cache) Objects aligned: yes.
+(slab-cache) Objects distinct: yes.
+(slab-cache) Objects constructed: yes.
+(slab-cache) Freed object reused: yes.
+(slab-cache) Constructor ran again on reuse: no.
+(slab-cache) end
+EOT
+pass;
@@ -0,0 +1,76 @@
+/* Checks the work queue: items queued in a burst all run,
+   requeuing a pending item has no effect, delayed work runs only
+   after its delay, and canceled work never runs. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "threads/workqueue.h"
+#include "devices/timer.h"
+
+#define WORK_CNT 10
+
+static work_func count_work;
+static work_func stamp_work;
+
+void
+test_workqueue (void) 
+{
+  struct workqueue *wq;
+  struct work items[WORK_CNT];
+  struct delayed_work delayed, canceled;
+  int count = 0;
+  int64_t delayed_at = 0, canceled_at = 0;
+  int64_t start;
+  int i;
+
+  ASSERT (!thread_mlfqs);
+
+  wq = workqueue_create ("wq", 2, PRI_DEFAULT);
+  if (wq == NULL)
+    fail ("workqueue_create() failed.");
+
+  for (i = 0; i < WORK_CNT; i++)
+    work_init (&items[i], count_work, &count);
+  for (i = 0; i < WORK_CNT; i++)
+    queue_work (wq, &items[i]);
+  flush_workqueue (wq);
+  msg ("Ran %d of %d work items.", count, WORK_CNT);
+
+  thread_set_priority (PRI_MAX);
+  queue_work (wq, &items[0]);
+  msg ("Queuing a pending item again: %s.",
+       queue_work (wq, &items[0]) ? "queued" : "ignored");
+  flush_work (wq, &items[0]);
+  thread_set_priority (PRI_DEFAULT);
+  msg ("Count after flush_work(): %d.", count);
+
+  delayed_work_init (&delayed, stamp_work, &delayed_at);
+  delayed_work_init (&canceled, stamp_work, &canceled_at);
+  start = timer_ticks ();
+  queue_delayed_work (wq, &delayed, 10);
+  queue_delayed_work (wq, &canceled, 10);
+  msg ("Canceling delayed work: %s.",
+       cancel_delayed_work (&canceled) ? "canceled" : "too late");
+
+  timer_sleep (20);
+  flush_workqueue (wq);
+  msg ("Delayed work ran after its delay: %s.",
+       delayed_at - start >= 10 ? "yes" : "no");
+  msg ("Canceled work ran: %s.", canceled_at != 0 ? "yes" : "no");
+}
+
+static void
+count_work (void *count_) 
+{
+  int *count = count_;
+  (*count)++;
+}
+
+static void
+stamp_work (void *at_) 
+{
+  int64_t *at = at_;
+  *at = timer_ticks ();
+}
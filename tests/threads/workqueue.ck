@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(workqueue) begin
+(workqueue) Ran 10 of 10 work items.
+(workqueue) Queuing a pending item again: ignored.
+(workqueue) Count after flush_work(): 11.
+(workqueue) Canceling delayed work: canceled.
+(workqueue) Delayed work ran after its delay: yes.
+(workqueue) Canceled work ran: no.
+(workqueue) end
+EOF
+pass;
@@ -0,0 +1,179 @@
+#include "threads/cpu.h"
+#include <debug.h>
+#include <packed.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/init.h"
+#include "threads/vaddr.h"
+
+/* Per-CPU data, indexed by CPU number.  cpus[0] is the boot
+   processor. */
+struct cpu cpus[CPU_MAX];
+
+/* Number of processors found, at least 1. */
+int cpu_cnt = 1;
+
+/* MP floating pointer structure, which locates the MP
+   configuration table.  See the Intel MultiProcessor
+   Specification, version 1.4, chapter 4. */
+struct mp_float
+{
+  char signature[4];   /* "_MP_". */
+  uint32_t config;     /* Physical address of configuration table. */
+  uint8_t length;      /* In 16-byte units. */
+  uint8_t spec_rev;    /* Specification revision. */
+  uint8_t checksum;    /* All bytes sum to 0. */
+  uint8_t type;        /* Default configuration type, if nonzero. */
+  uint8_t features[4]; /* Feature bytes. */
+} PACKED;
+
+/* MP configuration table header. */
+struct mp_config
+{
+  char signature[4];   /* "PCMP". */
+  uint16_t length;     /* Base table length, including header. */
+  uint8_t spec_rev;    /* Specification revision. */
+  uint8_t checksum;    /* All bytes of base table sum to 0. */
+  char oem_id[8];
+  char product_id[12];
+  uint32_t oem_table;
+  uint16_t oem_length;
+  uint16_t entry_cnt;  /* Number of entries after the header. */
+  uint32_t lapic;      /* Physical address of local APICs. */
+  uint16_t ext_length;
+  uint8_t ext_checksum;
+  uint8_t reserved;
+} PACKED;
+
+/* MP configuration table processor entry.  Other entry types
+   are 8 bytes long. */
+#define MP_PROCESSOR 0
+struct mp_processor
+{
+  uint8_t type;        /* MP_PROCESSOR. */
+  uint8_t apic_id;     /* Local APIC ID. */
+  uint8_t apic_version;
+  uint8_t flags;       /* MP_CPU_* below. */
+  uint32_t signature;
+  uint32_t features;
+  uint32_t reserved[2];
+} PACKED;
+#define MP_CPU_ENABLED 0x01 /* Usable. */
+#define MP_CPU_BSP 0x02     /* Boot processor. */
+
+static bool checksum_ok(const void *, size_t);
+static const struct mp_float *search_float(uintptr_t start, size_t size);
+static const struct mp_float *find_float(void);
+
+/* Finds the processors described by the MP configuration table,
+   recording them in cpus[] with the boot processor first.  Must
+   be called after paging_init(), since the table is in physical
+   memory. */
+void cpu_init(void)
+{
+  const struct mp_float *mpf = find_float();
+  const struct mp_config *conf;
+  const uint8_t *p, *end;
+
+  cpus[0].started = true;
+  if (mpf == NULL)
+  {
+    printf("cpu: no MP table, assuming a single processor\n");
+    return;
+  }
+  if (mpf->type != 0 || mpf->config == 0)
+  {
+    /* A default configuration has two processors. */
+    cpus[1].id = cpu_cnt++;
+    cpus[1].apic_id = 1;
+  }
+  else if (mpf->config >= init_ram_pages * PGSIZE)
+    printf("cpu: MP configuration table outside RAM, ignored\n");
+  else
+  {
+    conf = ptov(mpf->config);
+    if (memcmp(conf->signature, "PCMP", 4)
+        || !checksum_ok(conf, conf->length))
+    {
+      printf("cpu: bad MP configuration table, ignored\n");
+      return;
+    }
+    p = (const uint8_t *)(conf + 1);
+    end = (const uint8_t *)conf + conf->length;
+    while (p < end)
+    {
+      const struct mp_processor *proc = (const struct mp_processor *)p;
+
+      if (*p != MP_PROCESSOR)
+      {
+        p += 8;
+        continue;
+      }
+      p += sizeof *proc;
+      if (!(proc->flags & MP_CPU_ENABLED))
+        continue;
+      if (proc->flags & MP_CPU_BSP)
+        cpus[0].apic_id = proc->apic_id;
+      else if (cpu_cnt < CPU_MAX)
+      {
+        cpus[cpu_cnt].id = cpu_cnt;
+        cpus[cpu_cnt].apic_id = proc->apic_id;
+        cpu_cnt++;
+      }
+    }
+  }
+
+  if (cpu_cnt > 1)
+    printf("cpu: %d processors found, running on the boot processor only\n",
+           cpu_cnt);
+}
+
+/* Returns true if the SIZE bytes at P sum to 0 mod 256. */
+static bool
+checksum_ok(const void *p_, size_t size)
+{
+  const uint8_t *p = p_;
+  uint8_t sum = 0;
+
+  while (size-- > 0)
+    sum += *p++;
+  return sum == 0;
+}
+
+/* Searches the SIZE bytes of physical memory at START for a
+   valid MP floating pointer structure, which is aligned on a
+   16-byte boundary. */
+static const struct mp_float *
+search_float(uintptr_t start, size_t size)
+{
+  const struct mp_float *mpf = ptov(start);
+  const struct mp_float *end = ptov(start + size);
+
+  for (; mpf < end; mpf++)
+    if (!memcmp(mpf->signature, "_MP_", 4)
+        && mpf->length == 1
+        && checksum_ok(mpf, sizeof *mpf))
+      return mpf;
+  return NULL;
+}
+
+/* Returns the MP floating pointer structure, or a null pointer
+   if there is none.  It is in the first kB of the extended BIOS
+   data area, in the last kB of base memory, or in the BIOS ROM
+   between 0xf0000 and 0xfffff. */
+static const struct mp_float *
+find_float(void)
+{
+  const uint8_t *bda = ptov(0x400);
+  uintptr_t ebda = ((bda[0x0f] << 8) | bda[0x0e]) << 4;
+  uintptr_t base_kb = (bda[0x14] << 8) | bda[0x13];
+  const struct mp_float *mpf = NULL;
+
+  if (ebda != 0)
+    mpf = search_float(ebda, 1024);
+  if (mpf == NULL && base_kb != 0)
+    mpf = search_float(base_kb * 1024 - 1024, 1024);
+  if (mpf == NULL)
+    mpf = search_float(0xf0000, 0x10000);
+  return mpf;
+}
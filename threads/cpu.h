@@ -0,0 +1,46 @@
+#ifndef THREADS_CPU_H
+#define THREADS_CPU_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Per-CPU data.
+
+   cpu_init() finds the processors listed in the BIOS's MP
+   configuration table, but Pintos still runs on the boot
+   processor alone.  State that each processor needs a copy of,
+   such as its idle thread and its time slice, is kept here
+   rather than in globals, and reached through cpu_current(). */
+
+/* Most processors recorded. */
+#define CPU_MAX 8
+
+struct cpu
+{
+  int id;                    /* Index in cpus[]. */
+  uint8_t apic_id;           /* Local APIC ID. */
+  bool started;              /* Running Pintos? */
+
+  /* Owned by thread.c. */
+  struct thread *idle;       /* This CPU's idle thread. */
+  unsigned thread_ticks;     /* # of timer ticks since last yield. */
+  long long idle_ticks;      /* # of timer ticks spent idle. */
+  long long kernel_ticks;    /* # of timer ticks in kernel threads. */
+  long long user_ticks;      /* # of timer ticks in user programs. */
+};
+
+extern struct cpu cpus[CPU_MAX];
+extern int cpu_cnt;
+
+void cpu_init(void);
+
+/* Returns the running CPU.  Only the boot processor runs, so this
+   is always cpus[0]; with application processors started, it
+   would look up the local APIC ID. */
+static inline struct cpu *
+cpu_current(void)
+{
+  return &cpus[0];
+}
+
+#endif /* threads/cpu.h */
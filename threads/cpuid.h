@@ -0,0 +1,52 @@
+#ifndef THREADS_CPUID_H
+#define THREADS_CPUID_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/flags.h"
+
+/* CPUID feature bits returned in EDX by leaf 1.
+   See [IA32-v2a] "CPUID". */
+#define CPUID_EDX_TSC  0x00000010   /* Time-stamp counter. */
+#define CPUID_EDX_SSE2 0x04000000   /* SSE2 extensions. */
+
+/* Returns true if the CPU supports the CPUID instruction, which
+   is the case if software can toggle EFLAGS.ID. */
+static inline bool
+cpuid_supported (void)
+{
+  uint32_t before, after;
+
+  asm volatile ("pushfl; pushfl; popl %0; movl %0, %1; xorl %2, %1;"
+                "pushl %1; popfl; pushfl; popl %1; popfl"
+                : "=&r" (before), "=&r" (after) : "i" (FLAG_ID));
+  return ((before ^ after) & FLAG_ID) != 0;
+}
+
+/* Executes CPUID with EAX = LEAF and stores the resulting EAX,
+   EBX, ECX, EDX into REGS[0...3].  The CPU must support CPUID. */
+static inline void
+cpuid (uint32_t leaf, uint32_t regs[4])
+{
+  asm volatile ("cpuid"
+                : "=a" (regs[0]), "=b" (regs[1]), "=c" (regs[2]), "=d" (regs[3])
+                : "a" (leaf), "c" (0));
+}
+
+/* Returns the EDX feature bits of CPUID leaf 1, or 0 if the CPU
+   does not support CPUID. */
+static inline uint32_t
+cpuid_features (void)
+{
+  uint32_t regs[4];
+
+  if (!cpuid_supported ())
+    return 0;
+  cpuid (0, regs);
+  if (regs[0] < 1)
+    return 0;
+  cpuid (1, regs);
+  return regs[3];
+}
+
+#endif /* threads/cpuid.h */
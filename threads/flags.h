@@ -4,5 +4,6 @@
 /* EFLAGS Register. */
 #define FLAG_MBS  0x00000002    /* Must be set. */
 #define FLAG_IF   0x00000200    /* Interrupt Flag. */
+#define FLAG_ID   0x00200000    /* CPUID available. */
 
 #endif /* threads/flags.h */
@@ -15,12 +15,17 @@
 #include "devices/timer.h"
 #include "devices/vga.h"
 #include "devices/rtc.h"
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
+#include "threads/lockstat.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/profile.h"
+#include "threads/schedtrace.h"
+#include "threads/softirq.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -62,6 +67,7 @@ static void paging_init(void);
 
 static char **read_command_line(void);
 static char **parse_options(char **argv);
+static void select_scheduler(const char *policy);
 static void run_actions(char **argv);
 static void usage(void);
 
@@ -97,6 +103,7 @@ int main(void)
   palloc_init(user_page_limit);
   malloc_init();
   paging_init();
+  cpu_init();
 
   /* Segmentation. */
 #ifdef USERPROG
@@ -107,6 +114,8 @@ int main(void)
   /* Initialize interrupt handlers. */
   intr_init();
   timer_init();
+  schedtrace_init();
+  profile_init();
   kbd_init();
   input_init();
 #ifdef USERPROG
@@ -116,6 +125,7 @@ int main(void)
 
   /* Start thread scheduler and enable interrupts. */
   thread_start();
+  softirq_init();
   serial_init_queue();
   timer_calibrate();
 
@@ -256,7 +266,19 @@ parse_options(char **argv)
     else if (!strcmp(name, "-rs"))
       random_init(atoi(value));
     else if (!strcmp(name, "-mlfqs"))
-      thread_mlfqs = true;
+      select_scheduler("mlfqs");
+    else if (!strcmp(name, "-sched"))
+      select_scheduler(value);
+    else if (!strcmp(name, "-tickless"))
+      timer_tickless = true;
+    else if (!strcmp(name, "-lockstat"))
+      lockstat_enabled = true;
+    else if (!strcmp(name, "-schedtrace"))
+      schedtrace_enabled = true;
+    else if (!strcmp(name, "-profile"))
+      profile_enabled = true;
+    else if (!strcmp(name, "-threadstat"))
+      thread_print_times = true;
 #ifdef USERPROG
     else if (!strcmp(name, "-ul"))
       user_page_limit = atoi(value);
@@ -278,6 +300,22 @@ parse_options(char **argv)
   return argv;
 }
 
+/* Makes POLICY the scheduling policy, replacing any chosen by an
+   earlier option, so that at most one of thread_mlfqs and
+   thread_fair is ever set. */
+static void
+select_scheduler(const char *policy)
+{
+  thread_mlfqs = false;
+  thread_fair = false;
+  if (policy != NULL && !strcmp(policy, "mlfqs"))
+    thread_mlfqs = true;
+  else if (policy != NULL && !strcmp(policy, "fair"))
+    thread_fair = true;
+  else if (policy == NULL || strcmp(policy, "priority"))
+    PANIC("unknown scheduler `%s' (use -h for help)", policy ? policy : "");
+}
+
 /* Runs the task specified in ARGV[1]. */
 static void
 run_task(char **argv)
@@ -378,7 +416,15 @@ usage(void)
 #endif
 #endif
          "  -rs=SEED           Set random number seed to SEED.\n"
-         "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+         "  -mlfqs             Same as -sched=mlfqs.\n"
+         "  -sched=POLICY      Use scheduler POLICY: priority (default),\n"
+         "                     mlfqs, or fair (proportional share).\n"
+         "                     The last scheduler option given wins.\n"
+         "  -tickless          Stop the periodic timer tick while idle.\n"
+         "  -lockstat          Collect lock contention statistics.\n"
+         "  -schedtrace        Trace scheduler events, dump them at shutdown.\n"
+         "  -profile           Sample kernel stacks each tick, dump at shutdown.\n"
+         "  -threadstat        Print per-thread run, wait and block times at shutdown.\n"
 #ifdef USERPROG
          "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
@@ -4,12 +4,15 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "threads/flags.h"
 #include "threads/intr-stubs.h"
 #include "threads/io.h"
+#include "threads/softirq.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "devices/timer.h"
+#include "devices/tsc.h"
 
 /* Programmable Interrupt Controller (PIC) registers.
    A PC has two PICs, called the master and slave PICs, with the
@@ -44,10 +47,54 @@ static unsigned int unexpected_cnt[INTR_CNT];
    pre-empted.  Handlers for external interrupts also may not
    sleep, although they may invoke intr_yield_on_return() to
    request that a new process be scheduled just before the
-   interrupt returns. */
+   interrupt returns.
+
+   The one exception to nesting is softirqs (see softirq.h),
+   which run at the end of an external interrupt with interrupts
+   turned back on.  Another external interrupt may arrive while
+   they run; it leaves its own softirqs and any yield to the
+   outermost interrupt. */
 static bool in_external_intr; /* Are we processing an external interrupt? */
+static bool in_softirq;       /* Are we running softirqs on interrupt return? */
 static bool yield_on_return;  /* Should we yield on interrupt return? */
 
+/* Interrupt statistics.
+
+   Every interrupt is counted.  Once the TSC is calibrated,
+   intr_handler() also times each handler, and intr_disable()
+   and intr_enable() time the windows during which interrupts
+   are off, remembering the call site that opened the longest.
+   The time of an internal interrupt includes any time its
+   handler spent blocked. */
+
+/* Upper bounds of the handler duration histogram buckets, in ns;
+   the last bucket has no bound. */
+#define INTR_HIST_CNT 8
+static const uint64_t intr_hist_limit[INTR_HIST_CNT - 1] = {
+    1000, 4000, 16000, 64000, 256000, 1000000, 4000000};
+static const char *intr_hist_names[INTR_HIST_CNT] = {
+    "<1us", "<4us", "<16us", "<64us", "<256us", "<1ms", "<4ms", ">=4ms"};
+
+struct intr_stat
+{
+  unsigned long long cnt;         /* Times the vector fired. */
+  unsigned long long timed_cnt;   /* Of those, times it was timed. */
+  uint64_t total_ns;              /* Total, minimum and maximum */
+  uint64_t min_ns;                /* handler duration, in ns. */
+  uint64_t max_ns;
+  unsigned hist[INTR_HIST_CNT];   /* Durations by intr_hist_limit. */
+};
+static struct intr_stat intr_stats[INTR_CNT];
+
+static uint64_t off_start;        /* TSC when interrupts went off, or 0. */
+static const void *off_site;      /* Caller that turned them off. */
+static uint64_t off_max;          /* Longest interrupts-off window, */
+static const void *off_max_site;  /* and its caller. */
+
+static enum intr_level disable_at(const void *site);
+static void off_window_end(void);
+static void record_handler_time(struct intr_stat *, uint64_t cycles);
+
 /* Programmable Interrupt Controller helpers. */
 static void pic_init(void);
 static void pic_end_of_interrupt(int irq);
@@ -82,7 +129,8 @@ intr_get_level(void)
 enum intr_level
 intr_set_level(enum intr_level level)
 {
-  return level == INTR_ON ? intr_enable() : intr_disable();
+  return (level == INTR_ON ? intr_enable()
+                           : disable_at(__builtin_return_address(0)));
 }
 
 /* Enables interrupts and returns the previous interrupt status. */
@@ -90,7 +138,14 @@ enum intr_level
 intr_enable(void)
 {
   enum intr_level old_level = intr_get_level();
-  ASSERT(!intr_context());
+
+  /* Softirqs run in interrupt context with interrupts enabled,
+     but an external interrupt handler proper must not enable
+     them. */
+  ASSERT(!in_external_intr);
+
+  if (old_level == INTR_OFF)
+    off_window_end();
 
   /* Enable interrupts by setting the interrupt flag.
 
@@ -104,6 +159,14 @@ intr_enable(void)
 /* Disables interrupts and returns the previous interrupt status. */
 enum intr_level
 intr_disable(void)
+{
+  return disable_at(__builtin_return_address(0));
+}
+
+/* Disables interrupts on behalf of the caller at SITE and returns
+   the previous interrupt status. */
+static enum intr_level
+disable_at(const void *site)
 {
   enum intr_level old_level = intr_get_level();
 
@@ -115,9 +178,41 @@ intr_disable(void)
                :
                : "memory");
 
+  if (old_level == INTR_ON && tsc_calibrated())
+  {
+    off_start = rdtsc();
+    off_site = site;
+  }
   return old_level;
 }
 
+/* Informs the interrupt statistics that interrupts are about to
+   be enabled by some means other than intr_enable(), such as the
+   `sti; hlt' sequence in the idle thread.  Interrupts must be
+   off. */
+void intr_note_enable(void)
+{
+  ASSERT(intr_get_level() == INTR_OFF);
+  off_window_end();
+}
+
+/* Ends the current interrupts-off window, if one is being timed,
+   recording it if it is the longest so far. */
+static void
+off_window_end(void)
+{
+  if (off_start != 0)
+  {
+    uint64_t len = rdtsc() - off_start;
+    if (len > off_max)
+    {
+      off_max = len;
+      off_max_site = off_site;
+    }
+    off_start = 0;
+  }
+}
+
 /* Initializes the interrupt system. */
 void intr_init(void)
 {
@@ -210,11 +305,12 @@ void intr_register_int(uint8_t vec_no, int dpl, enum intr_level level,
   register_handler(vec_no, dpl, level, handler, name);
 }
 
-/* Returns true during processing of an external interrupt
-   and false at all other times. */
+/* Returns true during processing of an external interrupt,
+   including the softirqs run on its return, and false at all
+   other times. */
 bool intr_context(void)
 {
-  return in_external_intr;
+  return in_external_intr || in_softirq;
 }
 
 /* During processing of an external interrupt, directs the
@@ -276,6 +372,30 @@ pic_end_of_interrupt(int irq)
     outb(0xa0, 0x20);
 }
 
+/* Returns true if external interrupt VEC_NO has been raised but
+   not yet delivered, e.g. because interrupts are turned off.
+   Reads the PICs' interrupt request registers (OCW3). */
+bool intr_ext_pending(uint8_t vec_no)
+{
+  int irq = vec_no - 0x20;
+  uint8_t irr;
+
+  ASSERT(vec_no >= 0x20 && vec_no < 0x30);
+
+  if (irq < 8)
+  {
+    outb(PIC0_CTRL, 0x0a);
+    irr = inb(PIC0_CTRL);
+  }
+  else
+  {
+    outb(PIC1_CTRL, 0x0a);
+    irr = inb(PIC1_CTRL);
+    irq -= 8;
+  }
+  return (irr & (1 << irq)) != 0;
+}
+
 /* Creates an gate that invokes FUNCTION.
 
    The gate has descriptor privilege level DPL, meaning that it
@@ -345,6 +465,8 @@ make_idtr_operand(uint16_t limit, void *base)
    interrupted thread's registers. */
 void intr_handler(struct intr_frame *frame)
 {
+  struct intr_stat *stat = &intr_stats[frame->vec_no];
+  uint64_t start = tsc_calibrated() ? rdtsc() : 0;
   bool external;
   intr_handler_func *handler;
 
@@ -356,10 +478,11 @@ void intr_handler(struct intr_frame *frame)
   if (external)
   {
     ASSERT(intr_get_level() == INTR_OFF);
-    ASSERT(!intr_context());
+    ASSERT(!in_external_intr);
 
     in_external_intr = true;
-    yield_on_return = false;
+    if (!in_softirq)
+      yield_on_return = false;
   }
 
   /* Invoke the interrupt's handler. */
@@ -375,6 +498,10 @@ void intr_handler(struct intr_frame *frame)
   else
     unexpected_interrupt(frame);
 
+  stat->cnt++;
+  if (start != 0)
+    record_handler_time(stat, rdtsc() - start);
+
   /* Complete the processing of an external interrupt. */
   if (external)
   {
@@ -384,9 +511,77 @@ void intr_handler(struct intr_frame *frame)
     in_external_intr = false;
     pic_end_of_interrupt(frame->vec_no);
 
+    /* Run the bottom halves, unless we interrupted them. */
+    if (in_softirq)
+      return;
+    if (softirq_pending())
+    {
+      in_softirq = true;
+      softirq_run();
+      in_softirq = false;
+    }
+
     if (yield_on_return)
       thread_yield();
+
+    /* Returning from the interrupt turns interrupts back on. */
+    off_window_end();
+  }
+}
+
+/* Adds a handler run of CYCLES to STAT. */
+static void
+record_handler_time(struct intr_stat *stat, uint64_t cycles)
+{
+  uint64_t ns = tsc_to_ns(cycles);
+  int bucket;
+
+  if (stat->timed_cnt++ == 0 || ns < stat->min_ns)
+    stat->min_ns = ns;
+  if (ns > stat->max_ns)
+    stat->max_ns = ns;
+  stat->total_ns += ns;
+  for (bucket = 0; bucket < INTR_HIST_CNT - 1; bucket++)
+    if (ns < intr_hist_limit[bucket])
+      break;
+  stat->hist[bucket]++;
+}
+
+/* Prints interrupt statistics: for each vector that has fired,
+   its count, the minimum, average and maximum duration of its
+   handler, and a histogram of those durations; then the longest
+   time interrupts were off, with the address of the code that
+   turned them off, which the `backtrace' utility can translate
+   into a function name. */
+void intr_print_stats(void)
+{
+  enum intr_level old_level = intr_disable();
+  int vec, bucket;
+
+  printf("Interrupts:  vec name                  count   min(us)   avg(us)"
+         "   max(us)");
+  for (bucket = 0; bucket < INTR_HIST_CNT; bucket++)
+    printf(" %s", intr_hist_names[bucket]);
+  printf("\n");
+  for (vec = 0; vec < INTR_CNT; vec++)
+  {
+    struct intr_stat *stat = &intr_stats[vec];
+    uint64_t avg_ns;
+
+    if (stat->cnt == 0)
+      continue;
+    avg_ns = stat->timed_cnt > 0 ? stat->total_ns / stat->timed_cnt : 0;
+    printf("Interrupts: %#04x %-18s %8llu %9llu %9llu %9llu",
+           vec, intr_names[vec], stat->cnt, stat->min_ns / 1000,
+           avg_ns / 1000, stat->max_ns / 1000);
+    for (bucket = 0; bucket < INTR_HIST_CNT; bucket++)
+      printf(" %*u", (int)strlen(intr_hist_names[bucket]), stat->hist[bucket]);
+    printf("\n");
   }
+  if (off_max != 0)
+    printf("Interrupts: off for up to %llu us, disabled at %p\n",
+           tsc_to_ns(off_max) / 1000, off_max_site);
+  intr_set_level(old_level);
 }
 
 /* Handles an unexpected interrupt with interrupt frame F.  An
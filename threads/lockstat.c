@@ -0,0 +1,154 @@
+#include "threads/lockstat.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+
+/* Lock contention statistics for one lock name and call site. */
+struct lockstat_site
+{
+  const char *name;        /* Lock name, from lock_init()/sema_init(). */
+  const void *site;        /* Return address of the acquiring call. */
+  bool is_lock;            /* Lock, or plain semaphore? */
+  unsigned acquired_cnt;   /* Number of acquisitions. */
+  unsigned contended_cnt;  /* Acquisitions that had to wait. */
+  int64_t wait_total;      /* Total time spent waiting, in ns. */
+  int64_t wait_max;        /* Longest wait, in ns. */
+  int64_t hold_total;      /* Total time held (locks only), in ns. */
+  int64_t hold_max;        /* Longest hold (locks only), in ns. */
+};
+
+/* Statistics table, an open-addressed hash table keyed on name
+   and call site.  It is statically allocated because the memory
+   allocator itself is built on locks. */
+#define LOCKSTAT_SITES 256
+static struct lockstat_site sites[LOCKSTAT_SITES];
+
+/* Number of lookups that found the table full. */
+static unsigned dropped_cnt;
+
+bool lockstat_enabled;
+
+/* Returns a hash of NAME and SITE. */
+static unsigned
+hash_site(const char *name, const void *site)
+{
+  uint32_t h = (uint32_t)name * 2654435761u ^ (uint32_t)site;
+  return (h ^ (h >> 16)) % LOCKSTAT_SITES;
+}
+
+/* Returns the statistics for the lock or semaphore named NAME
+   acquired from call site SITE, creating them if necessary, or a
+   null pointer if the table is full.  May be called from an
+   interrupt handler. */
+struct lockstat_site *
+lockstat_lookup(const char *name, const void *site, bool is_lock)
+{
+  struct lockstat_site *s = NULL;
+  enum intr_level old_level;
+  unsigned i, h;
+
+  old_level = intr_disable();
+  h = hash_site(name, site);
+  for (i = 0; i < LOCKSTAT_SITES; i++)
+  {
+    struct lockstat_site *p = &sites[(h + i) % LOCKSTAT_SITES];
+    if (p->site == NULL)
+    {
+      p->name = name;
+      p->site = site;
+      p->is_lock = is_lock;
+      s = p;
+      break;
+    }
+    if (p->name == name && p->site == site)
+    {
+      s = p;
+      break;
+    }
+  }
+  if (s == NULL)
+    dropped_cnt++;
+  intr_set_level(old_level);
+
+  return s;
+}
+
+/* Records an acquisition through S after waiting WAIT_NS
+   nanoseconds, which is 0 unless CONTENDED. */
+void lockstat_acquired(struct lockstat_site *s, bool contended,
+                       int64_t wait_ns)
+{
+  enum intr_level old_level = intr_disable();
+
+  s->acquired_cnt++;
+  if (contended)
+  {
+    s->contended_cnt++;
+    s->wait_total += wait_ns;
+    if (wait_ns > s->wait_max)
+      s->wait_max = wait_ns;
+  }
+  intr_set_level(old_level);
+}
+
+/* Records the release of a lock acquired through S, after
+   holding it HOLD_NS nanoseconds. */
+void lockstat_released(struct lockstat_site *s, int64_t hold_ns)
+{
+  enum intr_level old_level = intr_disable();
+
+  s->hold_total += hold_ns;
+  if (hold_ns > s->hold_max)
+    s->hold_max = hold_ns;
+  intr_set_level(old_level);
+}
+
+/* Prints lock contention statistics, most contended (by total
+   wait time) first.  Call sites are return addresses, which the
+   "backtrace" utility translates to function names. */
+void lockstat_print_stats(void)
+{
+  static struct lockstat_site *sorted[LOCKSTAT_SITES];
+  size_t cnt = 0;
+  size_t i;
+
+  if (!lockstat_enabled)
+    return;
+
+  /* printf() takes the console lock, which must not update the
+     table while it is being printed. */
+  lockstat_enabled = false;
+
+  for (i = 0; i < LOCKSTAT_SITES; i++)
+  {
+    struct lockstat_site *s = &sites[i];
+    size_t j;
+
+    if (s->acquired_cnt == 0)
+      continue;
+    for (j = cnt++; j > 0 && sorted[j - 1]->wait_total < s->wait_total; j--)
+      sorted[j] = sorted[j - 1];
+    sorted[j] = s;
+  }
+
+  printf("Lockstat: %zu call sites", cnt);
+  if (dropped_cnt > 0)
+    printf(", %u acquisitions not recorded", dropped_cnt);
+  printf("\n%-20s %-10s %8s %8s %10s %10s %10s %10s\n", "name", "site",
+         "acq", "contend", "wait_us", "maxwait", "hold_us", "maxhold");
+  for (i = 0; i < cnt; i++)
+  {
+    struct lockstat_site *s = sorted[i];
+    const char *name = s->name[0] == '&' ? s->name + 1 : s->name;
+
+    printf("%-20.20s %10p %8u %8u %10" PRId64 " %10" PRId64, name, s->site,
+           s->acquired_cnt, s->contended_cnt, s->wait_total / 1000,
+           s->wait_max / 1000);
+    if (s->is_lock)
+      printf(" %10" PRId64 " %10" PRId64 "\n", s->hold_total / 1000,
+             s->hold_max / 1000);
+    else
+      printf(" %10s %10s\n", "-", "-");
+  }
+}
@@ -0,0 +1,29 @@
+#ifndef THREADS_LOCKSTAT_H
+#define THREADS_LOCKSTAT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Lock contention statistics.
+
+   When enabled, lock_acquire(), lock_try_acquire(),
+   lock_release() and sema_down() record, for every combination
+   of lock name and call site, how often the lock was acquired,
+   how often the caller had to wait for it, and how long it
+   waited and then held it.  The name is the expression passed to
+   lock_init() or sema_init(). */
+
+/* If false (default), no statistics are kept.
+   Controlled by kernel command-line option "-lockstat". */
+extern bool lockstat_enabled;
+
+struct lockstat_site;
+
+struct lockstat_site *lockstat_lookup(const char *name, const void *site,
+                                      bool is_lock);
+void lockstat_acquired(struct lockstat_site *, bool contended,
+                       int64_t wait_ns);
+void lockstat_released(struct lockstat_site *, int64_t hold_ns);
+void lockstat_print_stats(void);
+
+#endif /* threads/lockstat.h */
@@ -7,6 +7,7 @@
 #include <string.h>
 #include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
 /* A simple implementation of malloc().
@@ -28,6 +29,16 @@
    blocks, we remove all of the arena's blocks from the free list
    and give the arena back to the page allocator.
 
+   The descriptor's free list is protected by a lock, so in front
+   of it each thread keeps a "magazine" per descriptor: a small
+   stack of free blocks that only that thread touches.  malloc()
+   pops a block from the current thread's magazine and free()
+   pushes one, neither taking a lock.  Only when a magazine runs
+   empty or full is the descriptor's lock taken, to move half a
+   magazine of blocks at once.  Blocks in magazines count as in
+   use as far as their arenas are concerned.  A thread's
+   magazines are emptied when it exits.
+
    We can't handle blocks bigger than 2 kB using this scheme,
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
@@ -39,10 +50,15 @@ struct desc
 {
   size_t block_size;       /* Size of each element in bytes. */
   size_t blocks_per_arena; /* Number of blocks in an arena. */
+  size_t mag_size;         /* Most blocks in a magazine. */
+  size_t mag_batch;        /* Blocks moved per refill or flush. */
   struct list free_list;   /* List of free blocks. */
   struct lock lock;        /* Lock. */
 };
 
+/* Most blocks in a magazine, for the smallest blocks. */
+#define MAGAZINE_MAX 16
+
 /* Magic number for detecting arena corruption. */
 #define ARENA_MAGIC 0x9a548eed
 
@@ -58,14 +74,19 @@ struct arena
 struct block
 {
   struct list_elem free_elem; /* Free list element. */
+  struct block *mag_next;     /* Next block in a magazine. */
 };
 
 /* Our set of descriptors. */
-static struct desc descs[10]; /* Descriptors. */
-static size_t desc_cnt;       /* Number of descriptors. */
+static struct desc descs[MALLOC_CLASS_CNT]; /* Descriptors. */
+static size_t desc_cnt;                     /* Number of descriptors. */
 
 static struct arena *block_to_arena(struct block *);
 static struct block *arena_to_block(struct arena *, size_t idx);
+static bool refill_magazine(struct desc *, struct magazine *);
+static void flush_magazine(struct desc *, struct magazine *, size_t cnt);
+static void release_block(struct desc *, struct block *);
+static bool resize_in_place(void *block, size_t new_size);
 
 /* Initializes the malloc() descriptors. */
 void malloc_init(void)
@@ -78,6 +99,12 @@ void malloc_init(void)
     ASSERT(desc_cnt <= sizeof descs / sizeof *descs);
     d->block_size = block_size;
     d->blocks_per_arena = (PGSIZE - sizeof(struct arena)) / block_size;
+    d->mag_size = d->blocks_per_arena / 2;
+    if (d->mag_size > MAGAZINE_MAX)
+      d->mag_size = MAGAZINE_MAX;
+    else if (d->mag_size == 0)
+      d->mag_size = 1;
+    d->mag_batch = (d->mag_size + 1) / 2;
     list_init(&d->free_list);
     lock_init(&d->lock);
   }
@@ -89,6 +116,7 @@ void *
 malloc(size_t size)
 {
   struct desc *d;
+  struct magazine *m;
   struct block *b;
   struct arena *a;
 
@@ -118,37 +146,14 @@ malloc(size_t size)
     return a + 1;
   }
 
-  lock_acquire(&d->lock);
-
-  /* If the free list is empty, create a new arena. */
-  if (list_empty(&d->free_list))
-  {
-    size_t i;
-
-    /* Allocate a page. */
-    a = palloc_get_page(0);
-    if (a == NULL)
-    {
-      lock_release(&d->lock); //如果没有页表可用，直接放锁？
-      return NULL;
-    }
-
-    /* Initialize arena and add its blocks to the free list. */
-    a->magic = ARENA_MAGIC;
-    a->desc = d;
-    a->free_cnt = d->blocks_per_arena;
-    for (i = 0; i < d->blocks_per_arena; i++)
-    {
-      struct block *b = arena_to_block(a, i);
-      list_push_back(&d->free_list, &b->free_elem);
-    }
-  }
-
-  /* Get a block from free list and return it. */
-  b = list_entry(list_pop_front(&d->free_list), struct block, free_elem);
-  a = block_to_arena(b);
-  a->free_cnt--;
-  lock_release(&d->lock); //锁在这里已经被放掉了。。。理论上不存在什么排队的说法。。
+  /* Get a block from the current thread's magazine, refilling
+     it from the free list if it is empty. */
+  m = &thread_current()->magazines[d - descs];
+  if (m->cnt == 0 && !refill_magazine(d, m))
+    return NULL;
+  b = m->top;
+  m->top = b->mag_next;
+  m->cnt--;
   return b;
 }
 
@@ -185,7 +190,10 @@ block_size(void *block)
 }
 
 /* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
-   moving it in the process.
+   moving it in the process.  The block stays where it is if
+   its size class still fits, or if it is a big block that can
+   give back pages at its end or take over the free pages that
+   follow it.
    If successful, returns the new block; on failure, returns a
    null pointer.
    A call with null OLD_BLOCK is equivalent to malloc(NEW_SIZE).
@@ -198,6 +206,8 @@ realloc(void *old_block, size_t new_size)
     free(old_block);
     return NULL;
   }
+  else if (old_block != NULL && resize_in_place(old_block, new_size))
+    return old_block;
   else
   {
     void *new_block = malloc(new_size);
@@ -214,7 +224,7 @@ realloc(void *old_block, size_t new_size)
 
 /* Frees block P, which must have been previously allocated with
    malloc(), calloc(), or realloc(). */
-free(void *p)
+void free(void *p)
 {
   if (p != NULL)
   {
@@ -225,39 +235,161 @@ free(void *p)
     if (d != NULL)
     {
       /* It's a normal block.  We handle it here. */
+      struct magazine *m = &thread_current()->magazines[d - descs];
 
 #ifndef NDEBUG
       /* Clear the block to help detect use-after-free bugs. */
       memset(b, 0xcc, d->block_size);
 #endif
 
-      lock_acquire(&d->lock);
+      /* Push block onto the current thread's magazine, first
+         flushing part of it to the free list if it is full. */
+      if (m->cnt >= d->mag_size)
+        flush_magazine(d, m, d->mag_batch);
+      b->mag_next = m->top;
+      m->top = b;
+      m->cnt++;
+    }
+    else
+    {
+      /* It's a big block.  Free its pages. */
+      palloc_free_multiple(a, a->free_cnt);
+      return;
+    }
+  }
+}
+
+/* Tries to resize BLOCK to NEW_SIZE bytes without moving it.
+   Returns true if successful, false if BLOCK must move. */
+static bool
+resize_in_place(void *block, size_t new_size)
+{
+  struct arena *a = block_to_arena(block);
+  struct desc *d = a->desc;
+  size_t page_cnt;
+
+  if (d != NULL)
+  {
+    /* Keep a normal block if malloc(NEW_SIZE) would pick the
+       same descriptor, so that shrinking it a lot still frees
+       memory. */
+    return new_size <= d->block_size
+           && (d == descs || new_size > d[-1].block_size);
+  }
+
+  /* A big block shrunk enough to fit a descriptor must move. */
+  if (new_size <= descs[desc_cnt - 1].block_size)
+    return false;
+
+  page_cnt = DIV_ROUND_UP(new_size + sizeof *a, PGSIZE);
+  if (page_cnt < a->free_cnt)
+    palloc_free_multiple((uint8_t *)a + page_cnt * PGSIZE,
+                         a->free_cnt - page_cnt);
+  else if (page_cnt > a->free_cnt
+           && !palloc_extend_multiple(a, a->free_cnt, page_cnt))
+    return false;
+  a->free_cnt = page_cnt;
+  return true;
+}
+
+/* Returns the blocks in the current thread's magazines to their
+   descriptors' free lists.  Called by thread_exit(). */
+void malloc_thread_exit(void)
+{
+  struct thread *t = thread_current();
+  size_t i;
 
-      /* Add block to free list. */
-      list_push_front(&d->free_list, &b->free_elem);
+  for (i = 0; i < desc_cnt; i++)
+    if (t->magazines[i].cnt > 0)
+      flush_magazine(&descs[i], &t->magazines[i], t->magazines[i].cnt);
+}
 
-      /* If the arena is now entirely unused, free it. */
-      if (++a->free_cnt >= d->blocks_per_arena)
-      {
-        size_t i;
+/* Moves up to D's batch of free blocks from D's free list onto
+   magazine M, first creating a new arena if the free list is
+   empty.  Returns false if memory is not available. */
+static bool
+refill_magazine(struct desc *d, struct magazine *m)
+{
+  size_t i;
 
-        ASSERT(a->free_cnt == d->blocks_per_arena);
-        for (i = 0; i < d->blocks_per_arena; i++)
-        {
-          struct block *b = arena_to_block(a, i);
-          list_remove(&b->free_elem);
-        }
-        palloc_free_page(a);
-      }
+  lock_acquire(&d->lock);
 
+  /* If the free list is empty, create a new arena. */
+  if (list_empty(&d->free_list))
+  {
+    /* Allocate a page. */
+    struct arena *a = palloc_get_page(0);
+    if (a == NULL)
+    {
       lock_release(&d->lock);
+      return false;
     }
-    else
+
+    /* Initialize arena and add its blocks to the free list. */
+    a->magic = ARENA_MAGIC;
+    a->desc = d;
+    a->free_cnt = d->blocks_per_arena;
+    for (i = 0; i < d->blocks_per_arena; i++)
     {
-      /* It's a big block.  Free its pages. */
-      palloc_free_multiple(a, a->free_cnt);
-      return;
+      struct block *b = arena_to_block(a, i);
+      list_push_back(&d->free_list, &b->free_elem);
+    }
+  }
+
+  /* Move blocks from the free list to the magazine. */
+  for (i = 0; i < d->mag_batch && !list_empty(&d->free_list); i++)
+  {
+    struct block *b = list_entry(list_pop_front(&d->free_list),
+                                 struct block, free_elem);
+    block_to_arena(b)->free_cnt--;
+    b->mag_next = m->top;
+    m->top = b;
+    m->cnt++;
+  }
+
+  lock_release(&d->lock);
+  return true;
+}
+
+/* Moves CNT blocks from magazine M back to D's free list. */
+static void
+flush_magazine(struct desc *d, struct magazine *m, size_t cnt)
+{
+  ASSERT(cnt <= m->cnt);
+
+  lock_acquire(&d->lock);
+  while (cnt-- > 0)
+  {
+    struct block *b = m->top;
+    m->top = b->mag_next;
+    m->cnt--;
+    release_block(d, b);
+  }
+  lock_release(&d->lock);
+}
+
+/* Adds block B to D's free list, and frees B's arena if it is
+   now entirely unused.  D's lock must be held. */
+static void
+release_block(struct desc *d, struct block *b)
+{
+  struct arena *a = block_to_arena(b);
+
+  /* Add block to free list. */
+  list_push_front(&d->free_list, &b->free_elem);
+
+  /* If the arena is now entirely unused, free it. */
+  if (++a->free_cnt >= d->blocks_per_arena)
+  {
+    size_t i;
+
+    ASSERT(a->free_cnt == d->blocks_per_arena);
+    for (i = 0; i < d->blocks_per_arena; i++)
+    {
+      struct block *b = arena_to_block(a, i);
+      list_remove(&b->free_elem);
     }
+    palloc_free_page(a);
   }
 }
 
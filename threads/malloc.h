@@ -4,7 +4,19 @@
 #include <debug.h>
 #include <stddef.h>
 
+/* Number of malloc() size classes, from 16 to 1024 bytes. */
+#define MALLOC_CLASS_CNT 7
+
+/* A thread's private stack of free blocks of one size class.
+   See malloc.c. */
+struct magazine
+  {
+    void *top;                  /* Most recently freed block. */
+    size_t cnt;                 /* Number of blocks. */
+  };
+
 void malloc_init (void);
+void malloc_thread_exit (void);
 void *malloc (size_t) __attribute__ ((malloc));
 void *calloc (size_t, size_t) __attribute__ ((malloc));
 void *realloc (void *, size_t);
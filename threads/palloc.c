@@ -2,13 +2,15 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpuid.h"
 #include "threads/loader.h"
-#include "threads/synch.h"
+#include "threads/spinlock.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
@@ -23,22 +25,79 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
 
-/* A memory pool. */
+   Each pool is managed as a binary buddy system.  Free memory is
+   kept as blocks of 2**ORDER pages, each aligned (relative to the
+   pool's base) on its own size, on one free list per order.  A
+   free list links blocks through their first page, which is
+   otherwise unused.  An allocation takes the head of the
+   smallest nonempty list that fits, splitting the block in half
+   until it is the right size, so that a single page comes
+   straight off the order-0 list.  A freed block is merged with
+   its "buddy", the other half of the block it was split from,
+   for as long as the buddy is free too.  Requests that are not a
+   power of two get the next larger block, and the pages beyond
+   the request are freed again at once.
+
+   While there is nothing else to run, the idle thread takes free
+   pages out of the buddy system, zeroes them, and keeps them on
+   a short per-pool list, so that a single-page PAL_ZERO request
+   is usually served without clearing a page on the caller's
+   path.  The zeroing uses non-temporal stores where the CPU has
+   them, so it does not evict useful data from the cache.  If
+   the buddy system cannot satisfy a request, the zeroed pages
+   are given back to it and the request is retried. */
+
+/* Largest block order.  Blocks of 2**MAX_ORDER pages span 4 GB,
+   so no pool needs a larger one. */
+#define MAX_ORDER 20
+
+/* Entry in a pool's `orders' for a page that does not start a
+   free block. */
+#define NOT_FREE 0xff
+
+/* Most pre-zeroed pages kept per pool. */
+#define ZEROED_MAX 32
+
+/* A memory pool.
+
+   The spinlock, rather than a lock, protects the pool because
+   pages are freed from thread_schedule_tail(), where blocking is
+   not allowed. */
 struct pool
   {
-    struct lock lock;                   /* Mutual exclusion. */
-    struct bitmap *used_map;            /* Bitmap of free pages. */
+    struct spinlock lock;               /* Mutual exclusion. */
+    struct bitmap *used_map;            /* Bitmap of allocated pages. */
+    uint8_t *orders;                    /* Order of the free block
+                                           starting at each page,
+                                           or NOT_FREE. */
+    struct list free_lists[MAX_ORDER + 1]; /* Free blocks, by order. */
     uint8_t *base;                      /* Base of pool. */
+    size_t page_cnt;                    /* Number of pages in pool. */
+    void *zeroed[ZEROED_MAX];           /* Pre-zeroed pages. */
+    size_t zeroed_cnt;                  /* Number of pre-zeroed pages. */
+    unsigned long long zero_hits;       /* PAL_ZERO requests served
+                                           from `zeroed'. */
+    unsigned long long zero_misses;     /* PAL_ZERO requests cleared
+                                           on the caller's path. */
   };
 
 /* Two pools: one for kernel data, one for user pages. */
 static struct pool kernel_pool, user_pool;
 
+/* True if the CPU supports MOVNTI, an SSE2 instruction. */
+static bool have_movnti;
+
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static size_t alloc_range (struct pool *, size_t page_cnt);
+static void free_range (struct pool *, size_t page_idx, size_t page_cnt);
+static void claim_range (struct pool *, size_t page_idx, size_t page_cnt);
+static void release_zeroed (struct pool *);
+static void zero_pool (struct pool *);
+static void zero_page (void *);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -59,6 +118,8 @@ palloc_init (size_t user_page_limit)
   init_pool (&kernel_pool, free_start, kernel_pages, "kernel pool");
   init_pool (&user_pool, free_start + kernel_pages * PGSIZE,
              user_pages, "user pool");
+
+  have_movnti = (cpuid_features () & CPUID_EDX_SSE2) != 0;
 }
 
 /* Obtains and returns a group of PAGE_CNT contiguous free pages.
@@ -71,24 +132,43 @@ void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
-  void *pages;
+  enum intr_level old_level;
+  void *pages = NULL;
+  bool zeroed = false;
   size_t page_idx;
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
-
-  if (page_idx != BITMAP_ERROR)
-    pages = pool->base + PGSIZE * page_idx;
+  old_level = spinlock_acquire (&pool->lock);
+  if ((flags & PAL_ZERO) && page_cnt == 1 && pool->zeroed_cnt > 0)
+    {
+      pages = pool->zeroed[--pool->zeroed_cnt];
+      zeroed = true;
+      pool->zero_hits++;
+    }
   else
-    pages = NULL;
+    {
+      page_idx = alloc_range (pool, page_cnt);
+      if (page_idx == BITMAP_ERROR && pool->zeroed_cnt > 0)
+        {
+          release_zeroed (pool);
+          page_idx = alloc_range (pool, page_cnt);
+        }
+      if (page_idx != BITMAP_ERROR)
+        {
+          ASSERT (bitmap_none (pool->used_map, page_idx, page_cnt));
+          bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+          pages = pool->base + PGSIZE * page_idx;
+        }
+      if (flags & PAL_ZERO)
+        pool->zero_misses++;
+    }
+  spinlock_release (&pool->lock, old_level);
 
   if (pages != NULL) 
     {
-      if (flags & PAL_ZERO)
+      if ((flags & PAL_ZERO) && !zeroed)
         memset (pages, 0, PGSIZE * page_cnt);
     }
   else 
@@ -118,6 +198,7 @@ void
 palloc_free_multiple (void *pages, size_t page_cnt) 
 {
   struct pool *pool;
+  enum intr_level old_level;
   size_t page_idx;
 
   ASSERT (pg_ofs (pages) == 0);
@@ -137,8 +218,11 @@ palloc_free_multiple (void *pages, size_t page_cnt)
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
+  old_level = spinlock_acquire (&pool->lock);
   ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
   bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  free_range (pool, page_idx, page_cnt);
+  spinlock_release (&pool->lock, old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -148,25 +232,96 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Tries to extend the PAGE_CNT pages starting at PAGES, which
+   were obtained together from palloc_get_multiple(), to
+   NEW_PAGE_CNT pages without moving them.  Returns true if the
+   pages that follow were free and now belong to the allocation,
+   false if the allocation is unchanged.  The new pages are not
+   zeroed. */
+bool
+palloc_extend_multiple (void *pages, size_t page_cnt, size_t new_page_cnt) 
+{
+  struct pool *pool;
+  enum intr_level old_level;
+  size_t start, extra_cnt;
+  bool success = false;
+
+  ASSERT (pg_ofs (pages) == 0);
+  ASSERT (new_page_cnt > page_cnt);
+
+  if (page_from_pool (&kernel_pool, pages))
+    pool = &kernel_pool;
+  else if (page_from_pool (&user_pool, pages))
+    pool = &user_pool;
+  else
+    NOT_REACHED ();
+
+  start = pg_no (pages) - pg_no (pool->base) + page_cnt;
+  extra_cnt = new_page_cnt - page_cnt;
+  if (start + extra_cnt > pool->page_cnt)
+    return false;
+
+  old_level = spinlock_acquire (&pool->lock);
+  ASSERT (bitmap_all (pool->used_map, start - page_cnt, page_cnt));
+  if (bitmap_none (pool->used_map, start, extra_cnt))
+    {
+      claim_range (pool, start, extra_cnt);
+      bitmap_set_multiple (pool->used_map, start, extra_cnt, true);
+      success = true;
+    }
+  spinlock_release (&pool->lock, old_level);
+  return success;
+}
+
+/* Zeroes free pages for later PAL_ZERO requests, until each
+   pool's list of zeroed pages is full or the pool has no free
+   pages left.  Called by the idle thread, with interrupts on, so
+   that any thread that becomes ready preempts it. */
+void
+palloc_zero_idle (void) 
+{
+  zero_pool (&kernel_pool);
+  zero_pool (&user_pool);
+}
+
+/* Prints page zeroing statistics. */
+void
+palloc_print_stats (void) 
+{
+  printf ("Page zeroing: kernel pool %llu hits, %llu misses; "
+          "user pool %llu hits, %llu misses\n",
+          kernel_pool.zero_hits, kernel_pool.zero_misses,
+          user_pool.zero_hits, user_pool.zero_misses);
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
+  /* We'll put the pool's used_map and orders at its base.
+     Calculate the space needed for them and subtract it from
+     the pool's size. */
+  size_t bm_size = bitmap_buf_size (page_cnt);
+  size_t bm_pages = DIV_ROUND_UP (bm_size + page_cnt, PGSIZE);
+  int order;
+
   if (bm_pages > page_cnt)
     PANIC ("Not enough memory in %s for bitmap.", name);
   page_cnt -= bm_pages;
 
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
-  /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
+  /* Initialize the pool, with every page free. */
+  spinlock_init (&p->lock);
+  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_size);
+  p->orders = (uint8_t *) base + bm_size;
+  memset (p->orders, NOT_FREE, page_cnt);
+  for (order = 0; order <= MAX_ORDER; order++)
+    list_init (&p->free_lists[order]);
   p->base = base + bm_pages * PGSIZE;
+  p->page_cnt = page_cnt;
+  free_range (p, 0, page_cnt);
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -176,7 +331,210 @@ page_from_pool (const struct pool *pool, void *page)
 {
   size_t page_no = pg_no (page);
   size_t start_page = pg_no (pool->base);
-  size_t end_page = start_page + bitmap_size (pool->used_map);
+  size_t end_page = start_page + pool->page_cnt;
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* Returns the free list element in the first page of the block
+   at PAGE_IDX in POOL. */
+static struct list_elem *
+block_elem (const struct pool *pool, size_t page_idx)
+{
+  return (struct list_elem *) (pool->base + page_idx * PGSIZE);
+}
+
+/* Adds the free block of 2**ORDER pages at PAGE_IDX to POOL's
+   free lists, without merging it with its buddy. */
+static void
+push_block (struct pool *pool, size_t page_idx, int order)
+{
+  pool->orders[page_idx] = order;
+  list_push_front (&pool->free_lists[order], block_elem (pool, page_idx));
+}
+
+/* Removes the free block at PAGE_IDX from POOL's free lists. */
+static void
+remove_block (struct pool *pool, size_t page_idx)
+{
+  ASSERT (pool->orders[page_idx] != NOT_FREE);
+
+  list_remove (block_elem (pool, page_idx));
+  pool->orders[page_idx] = NOT_FREE;
+}
+
+/* Frees the block of 2**ORDER pages at PAGE_IDX in POOL, merging
+   it with its buddy for as long as the buddy is free. */
+static void
+free_block (struct pool *pool, size_t page_idx, int order)
+{
+  for (; order < MAX_ORDER; order++)
+    {
+      size_t buddy = page_idx ^ ((size_t) 1 << order);
+      if (buddy >= pool->page_cnt || pool->orders[buddy] != order)
+        break;
+      remove_block (pool, buddy);
+      page_idx &= ~((size_t) 1 << order);
+    }
+  push_block (pool, page_idx, order);
+}
+
+/* Frees the PAGE_CNT pages at PAGE_IDX in POOL, as the fewest
+   aligned blocks that cover them. */
+static void
+free_range (struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+  while (page_cnt > 0)
+    {
+      int order = 0;
+
+      while (order < MAX_ORDER
+             && page_idx % ((size_t) 2 << order) == 0
+             && ((size_t) 2 << order) <= page_cnt)
+        order++;
+      free_block (pool, page_idx, order);
+      page_idx += (size_t) 1 << order;
+      page_cnt -= (size_t) 1 << order;
+    }
+}
+
+/* Returns all of POOL's pre-zeroed pages to its free lists.
+   POOL's lock must be held. */
+static void
+release_zeroed (struct pool *pool) 
+{
+  while (pool->zeroed_cnt > 0)
+    {
+      void *page = pool->zeroed[--pool->zeroed_cnt];
+      size_t page_idx = pg_no (page) - pg_no (pool->base);
+
+      bitmap_reset (pool->used_map, page_idx);
+      free_range (pool, page_idx, 1);
+    }
+}
+
+/* Takes free pages out of POOL, zeroes them and adds them to
+   POOL's pre-zeroed pages, until there are ZEROED_MAX of those or
+   POOL has no free pages left.  A page is zeroed without the
+   lock held. */
+static void
+zero_pool (struct pool *pool) 
+{
+  for (;;)
+    {
+      enum intr_level old_level;
+      size_t page_idx;
+      void *page;
+
+      old_level = spinlock_acquire (&pool->lock);
+      page_idx = pool->zeroed_cnt < ZEROED_MAX ? alloc_range (pool, 1)
+                                               : BITMAP_ERROR;
+      if (page_idx != BITMAP_ERROR)
+        bitmap_mark (pool->used_map, page_idx);
+      spinlock_release (&pool->lock, old_level);
+      if (page_idx == BITMAP_ERROR)
+        return;
+
+      page = pool->base + PGSIZE * page_idx;
+      zero_page (page);
+
+      old_level = spinlock_acquire (&pool->lock);
+      if (pool->zeroed_cnt < ZEROED_MAX)
+        pool->zeroed[pool->zeroed_cnt++] = page;
+      else
+        {
+          bitmap_reset (pool->used_map, page_idx);
+          free_range (pool, page_idx, 1);
+        }
+      spinlock_release (&pool->lock, old_level);
+    }
+}
+
+/* Fills PAGE with zeros.  Uses non-temporal stores if possible,
+   which bypass the cache, since the page will not be touched
+   again until it is allocated. */
+static void
+zero_page (void *page) 
+{
+  uint32_t *p = page;
+  uint32_t *end = p + PGSIZE / sizeof *p;
+
+  if (!have_movnti)
+    {
+      memset (page, 0, PGSIZE);
+      return;
+    }
+
+  for (; p < end; p += 4)
+    asm volatile ("movnti %1, (%0); movnti %1, 4(%0);"
+                  "movnti %1, 8(%0); movnti %1, 12(%0)"
+                  : : "r" (p), "r" (0) : "memory");
+  asm volatile ("sfence" : : : "memory");
+}
+
+/* Takes the PAGE_CNT pages at PAGE_IDX in POOL, all of which
+   must be free, out of POOL's free lists.  Each free block that
+   holds some of them is removed, and its pages outside the range
+   are freed again. */
+static void
+claim_range (struct pool *pool, size_t page_idx, size_t page_cnt) 
+{
+  size_t end = page_idx + page_cnt;
+  size_t idx = page_idx;
+
+  while (idx < end)
+    {
+      size_t head, block_end;
+      int order;
+
+      /* Find the free block that contains page IDX. */
+      for (order = 0; order <= MAX_ORDER; order++)
+        {
+          head = idx & ~(((size_t) 1 << order) - 1);
+          if (pool->orders[head] == order)
+            break;
+        }
+      ASSERT (order <= MAX_ORDER);
+      block_end = head + ((size_t) 1 << order);
+
+      remove_block (pool, head);
+      if (head < page_idx)
+        free_range (pool, head, page_idx - head);
+      if (block_end > end)
+        free_range (pool, end, block_end - end);
+      idx = block_end;
+    }
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL and returns the
+   index of the first, or BITMAP_ERROR if no free block is large
+   enough. */
+static size_t
+alloc_range (struct pool *pool, size_t page_cnt)
+{
+  int want, order;
+  size_t page_idx;
+
+  if (page_cnt > (size_t) 1 << MAX_ORDER)
+    return BITMAP_ERROR;
+  for (want = 0; ((size_t) 1 << want) < page_cnt; want++)
+    continue;
+
+  for (order = want; list_empty (&pool->free_lists[order]); order++)
+    if (order == MAX_ORDER)
+      return BITMAP_ERROR;
+  page_idx = pg_no (list_front (&pool->free_lists[order]))
+             - pg_no (pool->base);
+  remove_block (pool, page_idx);
+
+  /* Split off upper halves until the block is the size wanted,
+     then give back the pages past the end of the request. */
+  while (order > want)
+    {
+      order--;
+      push_block (pool, page_idx + ((size_t) 1 << order), order);
+    }
+  if (page_cnt < (size_t) 1 << want)
+    free_range (pool, page_idx + page_cnt, ((size_t) 1 << want) - page_cnt);
+  return page_idx;
+}
@@ -0,0 +1,188 @@
+#include "threads/profile.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/loader.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "devices/serial.h"
+#ifdef USERPROG
+#include "userprog/gdt.h"
+#endif
+
+/* Most return addresses recorded per sample, including the
+   interrupted instruction itself. */
+#define PROFILE_DEPTH 8
+
+/* A call stack and the number of times it was sampled. */
+struct profile_entry
+{
+  uint32_t count;              /* Samples, or 0 if the slot is free. */
+  int32_t tid;                 /* Thread sampled. */
+  uint32_t pcs[PROFILE_DEPTH]; /* Innermost first; trailing slots 0. */
+};
+
+/* Pages in the sample table, and entries that fit in it. */
+#define PROFILE_PAGES 16
+#define PROFILE_ENTRIES (PROFILE_PAGES * PGSIZE / sizeof(struct profile_entry))
+
+bool profile_enabled;
+
+/* Hash table of call stacks, with open addressing. */
+static struct profile_entry *profile_table;
+
+/* Samples taken, and samples lost because the table was full. */
+static unsigned long long sample_cnt;
+static unsigned long long dropped_cnt;
+
+static int walk_stack(const struct intr_frame *, uint32_t *pcs);
+static void print_thread(struct thread *, void *);
+
+/* Allocates the sample table, if profiling is enabled. */
+void profile_init(void)
+{
+  if (!profile_enabled)
+    return;
+
+  profile_table = palloc_get_multiple(PAL_ZERO, PROFILE_PAGES);
+  if (profile_table == NULL)
+  {
+    printf("profile: no memory for sample table, profiling disabled\n");
+    profile_enabled = false;
+  }
+}
+
+/* Records a sample of the code interrupted by F.  Called from the
+   timer interrupt. */
+void profile_sample(const struct intr_frame *f)
+{
+  uint32_t pcs[PROFILE_DEPTH];
+  int32_t tid = thread_tid();
+  uint32_t hash = 2166136261u;
+  size_t i, probe;
+
+  ASSERT(intr_context());
+
+  if (profile_table == NULL)
+    return;
+
+  memset(pcs, 0, sizeof pcs);
+  walk_stack(f, pcs);
+
+  /* FNV-1a over the words of the key. */
+  hash = (hash ^ (uint32_t)tid) * 16777619u;
+  for (i = 0; i < PROFILE_DEPTH; i++)
+    hash = (hash ^ pcs[i]) * 16777619u;
+
+  sample_cnt++;
+  for (probe = 0; probe < PROFILE_ENTRIES; probe++)
+  {
+    struct profile_entry *e = &profile_table[(hash + probe) % PROFILE_ENTRIES];
+
+    if (e->count == 0)
+    {
+      e->tid = tid;
+      memcpy(e->pcs, pcs, sizeof pcs);
+    }
+    else if (e->tid != tid || memcmp(e->pcs, pcs, sizeof pcs))
+      continue;
+    e->count++;
+    return;
+  }
+  dropped_cnt++;
+}
+
+/* Stores the call stack of the code interrupted by F in PCS,
+   innermost first, and returns its depth.  Kernel frames are
+   found by following saved frame pointers, as long as they stay
+   within the running thread's stack page and move toward its
+   top.  A sample of user code, or of the kernel working for a
+   user process, ends with the user instruction pointer. */
+static int
+walk_stack(const struct intr_frame *f, uint32_t *pcs)
+{
+  uint8_t *page = pg_round_down(thread_current());
+  uint32_t *frame = f->frame_pointer;
+  int depth = 0;
+
+  pcs[depth++] = (uint32_t)f->eip;
+  if (f->cs != SEL_KCSEG)
+    return depth;
+
+  while (depth < PROFILE_DEPTH - 1
+         && (uint8_t *)frame >= page
+         && (uint8_t *)(frame + 2) <= page + PGSIZE
+         && frame[1] != 0)
+  {
+    uint32_t *caller = (uint32_t *)frame[0];
+
+    pcs[depth++] = frame[1];
+    if (caller <= frame)
+      break;
+    frame = caller;
+  }
+
+#ifdef USERPROG
+  /* A user process enters the kernel through an interrupt whose
+     frame is at the top of its kernel stack. */
+  if (thread_current()->pagedir != NULL)
+  {
+    const struct intr_frame *uf = (const struct intr_frame *)(page + PGSIZE) - 1;
+    if (uf->cs == SEL_UCSEG)
+      pcs[depth++] = (uint32_t)uf->eip;
+  }
+#endif
+  return depth;
+}
+
+/* Writes the sample counts to the serial port and stops
+   profiling.  Each "profile:" line gives a count, the thread,
+   and the call stack, innermost address first; "thread:" lines
+   name the threads still alive. */
+void profile_dump(void)
+{
+  char line[160];
+  enum intr_level old_level;
+  size_t i;
+
+  if (profile_table == NULL)
+    return;
+  profile_enabled = false;
+
+  snprintf(line, sizeof line, "profile: %llu samples, %llu dropped\n",
+           sample_cnt, dropped_cnt);
+  serial_puts(line);
+  old_level = intr_disable();
+  thread_foreach(print_thread, line);
+  intr_set_level(old_level);
+  for (i = 0; i < PROFILE_ENTRIES; i++)
+  {
+    const struct profile_entry *e = &profile_table[i];
+    int n, d;
+
+    if (e->count == 0)
+      continue;
+    n = snprintf(line, sizeof line, "profile: %" PRIu32 " %" PRId32,
+                 e->count, e->tid);
+    for (d = 0; d < PROFILE_DEPTH && e->pcs[d] != 0; d++)
+      n += snprintf(line + n, sizeof line - n, " %#" PRIx32, e->pcs[d]);
+    snprintf(line + n, sizeof line - n, "\n");
+    serial_puts(line);
+  }
+  serial_puts("profile: end\n");
+}
+
+/* Writes a line naming thread T to the serial port, using LINE_
+   as a buffer. */
+static void
+print_thread(struct thread *t, void *line_)
+{
+  char *line = line_;
+
+  snprintf(line, 160, "thread: %d %s\n", t->tid, t->name);
+  serial_puts(line);
+}
@@ -0,0 +1,27 @@
+#ifndef THREADS_PROFILE_H
+#define THREADS_PROFILE_H
+
+#include <stdbool.h>
+
+/* Statistical sampling profiler.
+
+   When enabled, every timer tick samples the interrupted code:
+   the instruction pointer and the return addresses found by
+   following the frame pointer chain, plus the user instruction
+   pointer of a user process.  Identical call stacks of the same
+   thread are counted together.  At shutdown the counts are
+   written over the serial port, for utils/pintos-profile to
+   symbolize against kernel.o as folded stacks for a flame
+   graph. */
+
+struct intr_frame;
+
+/* If false (default), nothing is sampled.
+   Controlled by kernel command-line option "-profile". */
+extern bool profile_enabled;
+
+void profile_init(void);
+void profile_sample(const struct intr_frame *);
+void profile_dump(void);
+
+#endif /* threads/profile.h */
@@ -0,0 +1,104 @@
+#include "threads/schedtrace.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "devices/serial.h"
+#include "devices/timer.h"
+#include "devices/tsc.h"
+
+/* One trace record. */
+struct schedtrace_rec
+{
+  uint64_t time;   /* TSC, or ns since boot without a TSC. */
+  int32_t tid;     /* Thread the event is about. */
+  uint8_t event;   /* enum schedtrace_event. */
+  int8_t priority; /* Thread's priority at the event. */
+  int16_t arg;     /* Event-specific argument. */
+};
+
+/* Pages in the trace buffer, and records that fit in it. */
+#define SCHEDTRACE_PAGES 16
+#define SCHEDTRACE_RECS (SCHEDTRACE_PAGES * PGSIZE / sizeof(struct schedtrace_rec))
+
+bool schedtrace_enabled;
+
+/* Ring buffer and the number of records ever claimed in it. */
+static struct schedtrace_rec *trace_buf;
+static unsigned trace_head;
+
+/* True if timestamps come from the TSC. */
+static bool trace_tsc;
+
+/* Allocates the trace buffer, if tracing is enabled.  Must be
+   called after timer_init(), which detects the TSC. */
+void schedtrace_init(void)
+{
+  if (!schedtrace_enabled)
+    return;
+
+  trace_buf = palloc_get_multiple(0, SCHEDTRACE_PAGES);
+  if (trace_buf == NULL)
+  {
+    printf("schedtrace: no memory for trace buffer, tracing disabled\n");
+    schedtrace_enabled = false;
+    return;
+  }
+  trace_tsc = tsc_present();
+}
+
+/* Appends an EVENT about thread TID, whose priority is PRIORITY,
+   with event-specific argument ARG, to the trace buffer,
+   overwriting the oldest record once the buffer is full.
+
+   Slots are claimed with an atomic increment, so this function
+   may be called from any context, with interrupts on or off,
+   without taking a lock. */
+void schedtrace_record(enum schedtrace_event event, int tid, int priority,
+                       int arg)
+{
+  struct schedtrace_rec *r;
+
+  if (trace_buf == NULL)
+    return;
+
+  r = &trace_buf[__sync_fetch_and_add(&trace_head, 1) % SCHEDTRACE_RECS];
+  r->time = trace_tsc ? rdtsc() : (uint64_t)timer_now_ns();
+  r->tid = tid;
+  r->event = event;
+  r->priority = priority;
+  r->arg = arg;
+}
+
+/* Writes the trace buffer to the serial port as CSV, oldest
+   record first, and stops tracing.  The header line gives the
+   timestamp unit. */
+void schedtrace_dump(void)
+{
+  static const char *event_names[] = {"wakeup", "out", "in", "block",
+                                      "priority", "tick"};
+  char line[80];
+  unsigned head, i;
+
+  if (trace_buf == NULL)
+    return;
+  schedtrace_enabled = false;
+
+  head = trace_head;
+  snprintf(line, sizeof line, "schedtrace: %u records, clock %s %" PRIu64 " Hz\n",
+           head < SCHEDTRACE_RECS ? head : SCHEDTRACE_RECS,
+           trace_tsc ? "tsc" : "ns",
+           trace_tsc ? tsc_hz() : (uint64_t)1000000000);
+  serial_puts(line);
+  serial_puts("time,event,tid,priority,arg\n");
+  for (i = head < SCHEDTRACE_RECS ? 0 : head - SCHEDTRACE_RECS; i != head; i++)
+  {
+    const struct schedtrace_rec *r = &trace_buf[i % SCHEDTRACE_RECS];
+
+    snprintf(line, sizeof line, "%" PRIu64 ",%s,%" PRId32 ",%d,%d\n",
+             r->time, event_names[r->event], r->tid, r->priority, r->arg);
+    serial_puts(line);
+  }
+  serial_puts("schedtrace: end\n");
+}
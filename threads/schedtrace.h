@@ -0,0 +1,49 @@
+#ifndef THREADS_SCHEDTRACE_H
+#define THREADS_SCHEDTRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Scheduler event tracing.
+
+   When enabled, the scheduler records its events in a ring
+   buffer, each with a timestamp from the TSC (or, on CPUs
+   without one, from timer_now_ns()).  The buffer is dumped over
+   the serial port as CSV at shutdown, to compute wakeup-to-run
+   latencies, run queue residency and the like offline. */
+
+/* Traced events. */
+enum schedtrace_event
+{
+  SCHEDTRACE_WAKEUP,     /* Thread made ready; ARG = waker's tid. */
+  SCHEDTRACE_SWITCH_OUT, /* Thread switched out; ARG = its status. */
+  SCHEDTRACE_SWITCH_IN,  /* Thread switched in; ARG = previous tid. */
+  SCHEDTRACE_BLOCK,      /* Thread blocked; ARG = block reason. */
+  SCHEDTRACE_PRIORITY,   /* Priority changed; ARG = old priority. */
+  SCHEDTRACE_TICK        /* Timer tick; ARG = 0. */
+};
+
+/* Why a thread blocked, for SCHEDTRACE_BLOCK. */
+enum schedtrace_block_reason
+{
+  SCHEDTRACE_BLOCK_WAIT,  /* On a semaphore, lock or condition. */
+  SCHEDTRACE_BLOCK_SLEEP  /* In timer_sleep(). */
+};
+
+/* If false (default), nothing is traced.
+   Controlled by kernel command-line option "-schedtrace". */
+extern bool schedtrace_enabled;
+
+void schedtrace_init(void);
+void schedtrace_record(enum schedtrace_event, int tid, int priority, int arg);
+void schedtrace_dump(void);
+
+/* Records an event if tracing is enabled. */
+#define SCHEDTRACE(EVENT, TID, PRIORITY, ARG)                   \
+  do                                                            \
+  {                                                             \
+    if (schedtrace_enabled)                                     \
+      schedtrace_record(SCHEDTRACE_##EVENT, TID, PRIORITY, ARG); \
+  } while (0)
+
+#endif /* threads/schedtrace.h */
@@ -0,0 +1,232 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Slab allocator.
+
+   Each slab is one page.  It begins with a `struct slab' header
+   and a bitmap with one bit per object, set while the object is
+   free, followed by the objects themselves.  Allocation takes
+   the lowest free object of the first slab on the cache's
+   `partial' list, which holds the slabs with at least one free
+   object.
+
+   The bytes left over at the end of a slab are used for cache
+   coloring: each new slab starts its objects SLAB_COLOR_STEP
+   bytes further into the page than the last one, wrapping
+   around when the leftover space runs out, so that the objects
+   at the same index in different slabs do not all compete for
+   the same cache lines. */
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Minimum distance between the colors of successive slabs. */
+#define SLAB_COLOR_STEP 32
+
+/* Bits in a bitmap word. */
+#define MAP_BITS 32
+
+/* An object cache. */
+struct kmem_cache
+{
+  char name[16];         /* Name (for debugging purposes). */
+  size_t size;           /* Object size, rounded up to `align'. */
+  size_t align;          /* Object alignment. */
+  kmem_ctor *ctor;       /* Constructor, or a null pointer. */
+  size_t objs_per_slab;  /* Number of objects in a slab. */
+  size_t objs_ofs;       /* Offset of the first object, uncolored. */
+  size_t color_max;      /* Largest color offset that fits. */
+  size_t color_step;     /* Distance between successive colors. */
+  size_t color_next;     /* Color offset of the next slab. */
+  struct list partial;   /* Slabs with free objects. */
+  struct lock lock;      /* Lock. */
+};
+
+/* Slab header, at the start of each slab's page. */
+struct slab
+{
+  unsigned magic;            /* Always set to SLAB_MAGIC. */
+  struct kmem_cache *cache;  /* Owning cache. */
+  struct list_elem elem;     /* Element in the cache's `partial'. */
+  size_t free_cnt;           /* Number of free objects. */
+  uint8_t *objs;             /* First object. */
+  uint32_t free_map[];       /* 1 bit per object, set if free. */
+};
+
+static struct slab *slab_create(struct kmem_cache *);
+static struct slab *obj_to_slab(struct kmem_cache *, void *);
+
+/* Creates and returns a cache of objects of SIZE bytes, each
+   aligned on ALIGN bytes, which must be a power of 2, or on a
+   word if ALIGN is 0.  If CTOR is nonnull, it is run on each
+   object when the object's slab is created.  Returns a null
+   pointer if memory is not available. */
+struct kmem_cache *
+kmem_cache_create(const char *name, size_t size, size_t align,
+                  kmem_ctor *ctor)
+{
+  struct kmem_cache *c;
+  size_t n;
+
+  if (align == 0)
+    align = sizeof(void *);
+  ASSERT(size > 0);
+  ASSERT((align & (align - 1)) == 0);
+
+  c = malloc(sizeof *c);
+  if (c == NULL)
+    return NULL;
+
+  strlcpy(c->name, name, sizeof c->name);
+  c->size = ROUND_UP(size, align);
+  c->align = align;
+  c->ctor = ctor;
+
+  /* Fit as many objects as possible, with their bitmap. */
+  for (n = (PGSIZE - sizeof(struct slab)) / c->size; n > 0; n--)
+  {
+    size_t map_size = DIV_ROUND_UP(n, MAP_BITS) * sizeof(uint32_t);
+    c->objs_ofs = ROUND_UP(sizeof(struct slab) + map_size, align);
+    if (c->objs_ofs + n * c->size <= PGSIZE)
+      break;
+  }
+  ASSERT(n > 0);
+  c->objs_per_slab = n;
+  c->color_max = PGSIZE - c->objs_ofs - n * c->size;
+  c->color_step = align > SLAB_COLOR_STEP ? align : SLAB_COLOR_STEP;
+  c->color_next = 0;
+
+  list_init(&c->partial);
+  lock_init(&c->lock);
+  return c;
+}
+
+/* Allocates and returns an object from cache C.  Returns a null
+   pointer if memory is not available. */
+void *
+kmem_cache_alloc(struct kmem_cache *c)
+{
+  struct slab *s;
+  size_t w, idx;
+
+  lock_acquire(&c->lock);
+  if (list_empty(&c->partial) && slab_create(c) == NULL)
+  {
+    lock_release(&c->lock);
+    return NULL;
+  }
+
+  s = list_entry(list_front(&c->partial), struct slab, elem);
+  for (w = 0; s->free_map[w] == 0; w++)
+    continue;
+  idx = w * MAP_BITS + __builtin_ctz(s->free_map[w]);
+  s->free_map[w] &= ~(1u << idx % MAP_BITS);
+  if (--s->free_cnt == 0)
+    list_remove(&s->elem);
+  lock_release(&c->lock);
+
+  return s->objs + idx * c->size;
+}
+
+/* Returns OBJ, which must have been allocated from cache C, to
+   C.  If C has a constructor, OBJ must be in its constructed
+   state. */
+void kmem_cache_free(struct kmem_cache *c, void *obj)
+{
+  struct slab *s;
+  size_t idx;
+  uint32_t bit;
+
+  if (obj == NULL)
+    return;
+
+  s = obj_to_slab(c, obj);
+  idx = ((uint8_t *)obj - s->objs) / c->size;
+  bit = 1u << idx % MAP_BITS;
+
+#ifndef NDEBUG
+  /* Clear the object to help detect use-after-free bugs.  A
+     constructed object has to stay intact. */
+  if (c->ctor == NULL)
+    memset(obj, 0xcc, c->size);
+#endif
+
+  lock_acquire(&c->lock);
+  ASSERT(!(s->free_map[idx / MAP_BITS] & bit));
+  s->free_map[idx / MAP_BITS] |= bit;
+  if (s->free_cnt++ == 0)
+    list_push_front(&c->partial, &s->elem);
+  else if (s->free_cnt == c->objs_per_slab
+           && (list_front(&c->partial) != &s->elem
+               || list_next(&s->elem) != list_end(&c->partial)))
+  {
+    /* The slab is unused and is not the last one with free
+       objects, so give its page back. */
+    list_remove(&s->elem);
+    s->magic = 0;
+    palloc_free_page(s);
+  }
+  lock_release(&c->lock);
+}
+
+/* Creates a slab for cache C, constructs its objects and adds it
+   to C's `partial' list.  Returns the new slab, or a null pointer
+   if no page is available.  C's lock must be held. */
+static struct slab *
+slab_create(struct kmem_cache *c)
+{
+  struct slab *s;
+  size_t i;
+
+  ASSERT(lock_held_by_current_thread(&c->lock));
+
+  s = palloc_get_page(0);
+  if (s == NULL)
+    return NULL;
+
+  s->magic = SLAB_MAGIC;
+  s->cache = c;
+  s->free_cnt = c->objs_per_slab;
+  s->objs = (uint8_t *)s + c->objs_ofs + c->color_next;
+  c->color_next += c->color_step;
+  if (c->color_next > c->color_max)
+    c->color_next = 0;
+
+  for (i = 0; i < DIV_ROUND_UP(c->objs_per_slab, MAP_BITS); i++)
+    s->free_map[i] = UINT32_MAX;
+  if (c->objs_per_slab % MAP_BITS != 0)
+    s->free_map[i - 1] = (1u << c->objs_per_slab % MAP_BITS) - 1;
+
+  if (c->ctor != NULL)
+    for (i = 0; i < c->objs_per_slab; i++)
+      c->ctor(s->objs + i * c->size);
+
+  list_push_front(&c->partial, &s->elem);
+  return s;
+}
+
+/* Returns the slab of cache C that OBJ is inside. */
+static struct slab *
+obj_to_slab(struct kmem_cache *c, void *obj)
+{
+  struct slab *s = pg_round_down(obj);
+
+  /* Check that the slab is valid. */
+  ASSERT(s->magic == SLAB_MAGIC);
+  ASSERT(s->cache == c);
+
+  /* Check that the object is properly aligned for the slab. */
+  ASSERT((uint8_t *)obj >= s->objs);
+  ASSERT(((uint8_t *)obj - s->objs) % c->size == 0);
+  ASSERT(((uint8_t *)obj - s->objs) / c->size < c->objs_per_slab);
+
+  return s;
+}
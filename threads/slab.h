@@ -0,0 +1,28 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <stddef.h>
+
+/* Object caches.
+
+   A cache hands out objects of one exact size, carved from
+   page-sized slabs, instead of rounding each request up to a
+   power of 2 the way malloc() does.  Each cache has its own
+   lock, so allocations of different kinds of object do not
+   contend with one another.
+
+   If a cache has a constructor, it is run on each object once,
+   when the slab holding it is created, rather than on every
+   allocation.  An object must therefore be returned to its
+   cache in its constructed state. */
+
+struct kmem_cache;
+
+typedef void kmem_ctor(void *obj);
+
+struct kmem_cache *kmem_cache_create(const char *name, size_t size,
+                                     size_t align, kmem_ctor *);
+void *kmem_cache_alloc(struct kmem_cache *);
+void kmem_cache_free(struct kmem_cache *, void *);
+
+#endif /* threads/slab.h */
@@ -0,0 +1,157 @@
+#include "threads/softirq.h"
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Rounds of softirq processing on interrupt return before the
+   rest is handed to ksoftirqd. */
+#define SOFTIRQ_MAX_RESTART 10
+
+/* Handlers and names of the softirqs. */
+static softirq_func *handlers[SOFTIRQ_CNT];
+static const char *names[SOFTIRQ_CNT] = {"timer", "block"};
+
+/* Bit N is set if softirq N is pending.  Protected by disabling
+   interrupts. */
+static uint32_t pending;
+
+/* True while softirqs are being processed, either on interrupt
+   return or by ksoftirqd, so that they never run concurrently
+   with themselves. */
+static bool running;
+
+/* Wakes ksoftirqd, once it has been started. */
+static struct semaphore ksoftirqd_wake;
+static bool ksoftirqd_started;
+
+/* Statistics. */
+static long long run_cnt[SOFTIRQ_CNT]; /* # of times each handler ran. */
+static long long deferred_cnt;         /* # of backlogs given to ksoftirqd. */
+
+static void ksoftirqd(void *aux UNUSED);
+static bool process_pending(void);
+
+/* Starts the ksoftirqd thread.  Until this is called, a backlog
+   of softirqs waits for the next interrupt. */
+void softirq_init(void)
+{
+  sema_init(&ksoftirqd_wake, 0);
+  if (thread_create("ksoftirqd", PRI_MAX, ksoftirqd, NULL) == TID_ERROR)
+    PANIC("cannot start ksoftirqd");
+  ksoftirqd_started = true;
+}
+
+/* Registers HANDLER to run whenever softirq NR is raised. */
+void softirq_register(enum softirq_nr nr, softirq_func *handler)
+{
+  ASSERT(nr < SOFTIRQ_CNT);
+  ASSERT(handlers[nr] == NULL);
+
+  handlers[nr] = handler;
+}
+
+/* Marks softirq NR pending, to run on return from the current
+   interrupt, or on return from the next one if not called from
+   an interrupt handler.  May be called from any context. */
+void softirq_raise(enum softirq_nr nr)
+{
+  enum intr_level old_level;
+
+  ASSERT(nr < SOFTIRQ_CNT);
+  ASSERT(handlers[nr] != NULL);
+
+  old_level = intr_disable();
+  pending |= 1u << nr;
+  intr_set_level(old_level);
+}
+
+/* Returns true if any softirq is pending. */
+bool softirq_pending(void)
+{
+  return pending != 0;
+}
+
+/* Runs pending softirqs.  Called by the interrupt handler just
+   before returning from an external interrupt, with interrupts
+   off; turns interrupts on while the handlers run and returns
+   with them off again.  Does nothing if softirqs are already
+   being processed by an outer invocation or by ksoftirqd. */
+void softirq_run(void)
+{
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (running)
+    return;
+  running = true;
+  if (!process_pending() && ksoftirqd_started)
+  {
+    deferred_cnt++;
+    sema_up(&ksoftirqd_wake);
+  }
+  running = false;
+}
+
+/* Prints softirq statistics. */
+void softirq_print_stats(void)
+{
+  int nr;
+
+  printf("Softirq:");
+  for (nr = 0; nr < SOFTIRQ_CNT; nr++)
+    printf(" %lld %s,", run_cnt[nr], names[nr]);
+  printf(" %lld deferred to ksoftirqd\n", deferred_cnt);
+}
+
+/* Runs pending softirqs with interrupts on, repeating while more
+   are raised, up to SOFTIRQ_MAX_RESTART rounds.  Returns true if
+   none are left pending.  Interrupts must be off on entry, and
+   are off again on return. */
+static bool
+process_pending(void)
+{
+  int round;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  for (round = 0; pending != 0 && round < SOFTIRQ_MAX_RESTART; round++)
+  {
+    uint32_t todo = pending;
+    int nr;
+
+    pending = 0;
+    intr_enable();
+    for (nr = 0; nr < SOFTIRQ_CNT; nr++)
+      if (todo & (1u << nr))
+      {
+        run_cnt[nr]++;
+        handlers[nr]();
+      }
+    intr_disable();
+  }
+  return pending == 0;
+}
+
+/* Thread that processes softirqs that were raised faster than
+   interrupt returns could process them, yielding between rounds
+   so that other threads make progress. */
+static void
+ksoftirqd(void *aux UNUSED)
+{
+  for (;;)
+  {
+    intr_disable();
+    while (pending == 0)
+      sema_down(&ksoftirqd_wake);
+    if (!running)
+    {
+      running = true;
+      process_pending();
+      running = false;
+    }
+    intr_enable();
+    thread_yield();
+  }
+}
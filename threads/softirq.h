@@ -0,0 +1,36 @@
+#ifndef THREADS_SOFTIRQ_H
+#define THREADS_SOFTIRQ_H
+
+#include <stdbool.h>
+
+/* Softirqs: deferred halves of external interrupt handlers.
+
+   An interrupt handler's top half does only what must be done
+   at once with interrupts off, such as acknowledging the device,
+   and raises a softirq for the rest.  Pending softirqs run just
+   before the interrupt returns, with interrupts on, so that
+   further interrupts are taken while they run.  Their handlers
+   still run in interrupt context and may not sleep.
+
+   If softirqs keep being raised while they run, the backlog is
+   handed to the ksoftirqd thread instead of holding up the
+   interrupted thread indefinitely.  Softirq handlers must
+   therefore also work in thread context.  There is a single
+   CPU, so there is a single ksoftirqd. */
+enum softirq_nr
+{
+  SOFTIRQ_TIMER, /* Timer tick bookkeeping. */
+  SOFTIRQ_BLOCK, /* Block device completions. */
+  SOFTIRQ_CNT    /* Number of softirqs. */
+};
+
+typedef void softirq_func(void);
+
+void softirq_init(void);
+void softirq_register(enum softirq_nr, softirq_func *);
+void softirq_raise(enum softirq_nr);
+bool softirq_pending(void);
+void softirq_run(void);
+void softirq_print_stats(void);
+
+#endif /* threads/softirq.h */
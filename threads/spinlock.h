@@ -0,0 +1,59 @@
+#ifndef THREADS_SPINLOCK_H
+#define THREADS_SPINLOCK_H
+
+#include <debug.h>
+#include <stddef.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+
+/* Spinlock.
+
+   Protects data that interrupt handlers also touch, for code
+   that would otherwise just turn interrupts off.  Acquiring a
+   spinlock turns interrupts off, which is all the exclusion a
+   single processor needs, and then claims the lock with an
+   atomic exchange, which is what excludes other processors.
+   Spinlocks must be held only briefly and never while
+   sleeping. */
+struct spinlock
+{
+  volatile int locked; /* 1 if held, 0 otherwise. */
+  struct cpu *holder;  /* CPU holding it (for debugging). */
+};
+
+/* Initializes SL as unlocked. */
+static inline void
+spinlock_init(struct spinlock *sl)
+{
+  sl->locked = 0;
+  sl->holder = NULL;
+}
+
+/* Turns interrupts off and acquires SL, spinning while another
+   processor holds it.  Returns the previous interrupt level, to
+   pass to spinlock_release(). */
+static inline enum intr_level
+spinlock_acquire(struct spinlock *sl)
+{
+  enum intr_level old_level = intr_disable();
+
+  ASSERT(!(sl->locked && sl->holder == cpu_current()));
+  while (__sync_lock_test_and_set(&sl->locked, 1))
+    asm volatile("pause");
+  sl->holder = cpu_current();
+  return old_level;
+}
+
+/* Releases SL and restores the interrupt level OLD_LEVEL
+   returned by spinlock_acquire(). */
+static inline void
+spinlock_release(struct spinlock *sl, enum intr_level old_level)
+{
+  ASSERT(sl->locked && sl->holder == cpu_current());
+
+  sl->holder = NULL;
+  __sync_lock_release(&sl->locked);
+  intr_set_level(old_level);
+}
+
+#endif /* threads/spinlock.h */
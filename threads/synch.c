@@ -31,9 +31,14 @@
 #include <stdlib.h>
 #include <string.h>
 #include "threads/interrupt.h"
+#include "threads/lockstat.h"
+#include "threads/schedtrace.h"
 #include "threads/thread.h"
+#include "devices/timer.h"
 #include "lib/kernel/list.h"
-#include "threads/malloc.h"
+
+static void wait_queue_init(struct heap *);
+static bool sema_wait(struct semaphore *);
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -44,12 +49,64 @@
 
    - up or "V": increment the value (and wake up one waiting
      thread, if any). */
-void sema_init(struct semaphore *sema, unsigned value)
+void sema_init_named(struct semaphore *sema, unsigned value, const char *name)
 {
   ASSERT(sema != NULL);
 
   sema->value = value;
-  list_init(&sema->waiters);
+  sema->name = name;
+  wait_queue_init(&sema->waiters);
+}
+
+/* Orders waiting threads by priority, highest first, and threads
+   of equal priority in the order they started waiting. */
+static bool
+waiter_less(const struct heap_elem *a_, const struct heap_elem *b_,
+            void *aux UNUSED)
+{
+  const struct thread *a = heap_entry(a_, struct thread, waitelem);
+  const struct thread *b = heap_entry(b_, struct thread, waitelem);
+
+  if (a->priority != b->priority)
+    return a->priority > b->priority;
+  return (int)(a->wait_seq - b->wait_seq) < 0;
+}
+
+/* Initializes WAITERS as an empty queue of waiting threads. */
+static void
+wait_queue_init(struct heap *waiters)
+{
+  heap_init(waiters, waiter_less, NULL);
+}
+
+/* Adds the running thread to WAITERS.  The thread's priority may
+   change while it waits, through donation; thread_promote() then
+   moves it within WAITERS.  Interrupts must be off. */
+static void
+wait_queue_push(struct heap *waiters)
+{
+  static unsigned next_seq;
+  struct thread *cur = thread_current();
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  cur->wait_seq = next_seq++;
+  cur->wait_queue = waiters;
+  heap_insert(waiters, &cur->waitelem);
+}
+
+/* Removes and returns the highest-priority thread in WAITERS,
+   which must not be empty.  Interrupts must be off. */
+static struct thread *
+wait_queue_pop(struct heap *waiters)
+{
+  struct thread *t;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  t = heap_entry(heap_pop_front(waiters), struct thread, waitelem);
+  t->wait_queue = NULL;
+  return t;
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -61,21 +118,42 @@ void sema_init(struct semaphore *sema, unsigned value)
    thread will probably turn interrupts back on. */
 void sema_down(struct semaphore *sema)
 {
-  enum intr_level old_level;
+  struct lockstat_site *stat = NULL;
+  int64_t start = 0;
+  bool contended;
 
   ASSERT(sema != NULL);
   ASSERT(!intr_context());
 
+  if (lockstat_enabled)
+  {
+    stat = lockstat_lookup(sema->name, __builtin_return_address(0), false);
+    start = timer_now_ns();
+  }
+  contended = sema_wait(sema);
+  if (stat != NULL)
+    lockstat_acquired(stat, contended, contended ? timer_now_ns() - start : 0);
+}
+
+/* Does the work of sema_down(), without lock statistics.
+   Returns true if the caller had to wait. */
+static bool
+sema_wait(struct semaphore *sema)
+{
+  enum intr_level old_level;
+  bool waited = false;
+
   old_level = intr_disable();
-  struct thread *cur = thread_current();
   while (sema->value == 0)
   {
-    list_push_ordered(&sema->waiters, &thread_current()->elem, thread_current()->priority);
-    //list_push_back(&sema->waiters, &thread_current()->elem);
+    wait_queue_push(&sema->waiters);
     thread_block(false);
+    waited = true;
   }
   sema->value--;
   intr_set_level(old_level);
+
+  return waited;
 }
 
 /* Down or "P" operation on a semaphore, but only if the
@@ -103,13 +181,11 @@ bool sema_try_down(struct semaphore *sema)
   return success;
 }
 
-bool sema_cmp(const struct list_elem *a, const struct list_elem *b, void *null) //the comparsion function
-{
-  return list_entry(a, struct thread, elem)->priority > list_entry(b, struct thread, elem)->priority;
-}
-
 /* Up or "V" operation on a semaphore.  Increments SEMA's value
    and wakes up one thread of those waiting for SEMA, if any.
+   The highest-priority waiter is woken, and it preempts the
+   caller if its priority is higher, unless the caller has
+   interrupts disabled.
 
    This function may be called from an interrupt handler. */
 void sema_up(struct semaphore *sema)
@@ -119,19 +195,17 @@ void sema_up(struct semaphore *sema)
   ASSERT(sema != NULL);
 
   old_level = intr_disable();
-  if (!list_empty(&sema->waiters)) //while
-  {
-    list_sort(&sema->waiters, sema_cmp, NULL); //make the waiting list into ordered
-    struct thread *thread = list_entry(list_pop_front(&sema->waiters), struct thread, elem);
-
-    thread_unblock(thread);
-  }
+  if (!heap_empty(&sema->waiters))
+    thread_unblock(wait_queue_pop(&sema->waiters));
   sema->value++;
-  thread_yield();
   intr_set_level(old_level);
+  thread_preempt();
 }
 
 static void sema_test_helper(void *sema_);
+static void take_donations(struct lock *);
+static void lock_acquired_stat(struct lock *, struct lockstat_site *, bool,
+                               int64_t);
 
 /* Self-test for semaphores that makes control "ping-pong"
    between a pair of threads.  Insert calls to printf() to see
@@ -182,12 +256,14 @@ sema_test_helper(void *sema_)
    acquire and release it.  When these restrictions prove
    onerous, it's a good sign that a semaphore should be used,
    instead of a lock. */
-void lock_init(struct lock *lock)
+void lock_init_named(struct lock *lock, const char *name)
 {
   ASSERT(lock != NULL);
 
   lock->holder = NULL;
-  sema_init(&lock->semaphore, 1);
+  lock->max_priority = PRI_MIN;
+  lock->stat = NULL;
+  sema_init_named(&lock->semaphore, 1, name);
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -200,87 +276,120 @@ void lock_init(struct lock *lock)
    we need to sleep. */
 void lock_acquire(struct lock *lock)
 {
+  struct thread *cur = thread_current();
+  struct lockstat_site *stat = NULL;
+  int64_t start = 0;
+  bool contended;
+
   ASSERT(lock != NULL);
   ASSERT(!intr_context());
   ASSERT(!lock_held_by_current_thread(lock));
+  if (lockstat_enabled)
+  {
+    stat = lockstat_lookup(lock->semaphore.name, __builtin_return_address(0),
+                           true);
+    start = timer_now_ns();
+  }
   enum intr_level old_level = intr_disable();
-  if (lock->holder != NULL&&!thread_mlfqs)
+  if (lock->holder != NULL && !thread_mlfqs)
+  {
+    cur->waiting_lock = lock;
     donate_priority(lock);
-  sema_down(&lock->semaphore);
+  }
+  contended = sema_wait(&lock->semaphore);
+  cur->waiting_lock = NULL;
+  lock->holder = cur;
+  if (!thread_mlfqs)
+    take_donations(lock);
   intr_set_level(old_level);
-  lock->holder = thread_current();
+  lock_acquired_stat(lock, stat, contended, start);
 }
 
-/* 
+/* Records in lock statistics STAT, if non-null, that LOCK was
+   just acquired, after waiting since START if CONTENDED. */
+static void
+lock_acquired_stat(struct lock *lock, struct lockstat_site *stat,
+                   bool contended, int64_t start)
+{
+  lock->stat = stat;
+  if (stat != NULL)
+  {
+    lock->acquired_ns = timer_now_ns();
+    lockstat_acquired(stat, contended,
+                      contended ? lock->acquired_ns - start : 0);
+  }
+}
+
+/* Longest chain of nested donations that donate_priority()
+   follows: a thread waiting on a lock whose holder waits on a
+   lock whose holder waits ...  Deeper chains are cut off. */
+#define DONATION_DEPTH_MAX 8
+
+/*
   捐赠优先级入口
-  将锁分为直接锁和递归锁。在donation_log的bool值上标明
+  当前线程即将在LOCK上等待：沿着"锁 -> 持有者 -> 持有者等待的锁"这条链
+  向上捐赠，只触及链上的锁和线程，不需要分配内存。
  */
 void donate_priority(struct lock *lock)
 {
   enum intr_level old_level = intr_disable();
+  int pri = thread_current()->priority;
+  int depth;
 
-  struct thread *cur = thread_current();
-  struct thread *holder = lock->holder;
-  int cur_should_be;
-  // cur->priority < holder->priority
-  if (cur->priority > holder->priority)
+  for (depth = 0; lock != NULL && depth < DONATION_DEPTH_MAX; depth++)
   {
-    struct donation_log *log = NULL;
-    struct donation_log *new_log;
-    //创建一个捐赠记录并把它接到列表尾部
-    do
-    {
-      //当找到递归捐赠记录时，需要在生成新记录前改变一些设置
-      //当需要递归捐赠时，相当于是最高优先级的线程向捐赠链中的每一个环节都请求一次锁。
-      if (log != NULL) //log == NULL意味着是非递归捐赠
-      {
-        holder = log->receiver;
-        lock = log->mutex;
-        log->is_nest_donation = true;
-      }
-      new_log = (struct donation_log *)malloc(sizeof(struct donation_log));
-      //这里可不能随便free。。。free掉了整个donation_log就从内存中消失了
-      new_log->donator = cur;
-      new_log->donator_pri = cur->priority;
-      new_log->mutex = lock;
-      new_log->receiver = holder;
-      new_log->receiver_pri = holder->priority;
-      new_log->is_nest_donation = (log == NULL ? false : true); //若是递归捐赠，设置提示位
-      cur_should_be = holder->priority;
-      holder->priority = cur->priority;
-      list_insert_ordered(&donation_list, &new_log->don_elem, less, NULL);
-
-      //交换优先级后需要将ready-list里高优先级的线程提前
-      if (holder->status == THREAD_READY)
-        thread_promote(holder);
-    } while ((log = find_donation_log(new_log->receiver)) != NULL);
-    cur->priority = cur_should_be;
+    struct thread *holder = lock->holder;
+
+    if (lock->max_priority < pri)
+      lock->max_priority = pri;
+    if (holder == NULL || holder->priority >= pri)
+      break;
+    SCHEDTRACE(PRIORITY, holder->tid, pri, holder->priority);
+    holder->priority = pri;
+
+    //交换优先级后需要将ready-list里高优先级的线程提前
+    thread_promote(holder);
+    lock = holder->waiting_lock;
   }
 
   intr_set_level(old_level);
 }
 
-struct donation_log *find_donation_log(struct thread *my_thread)
+/* Called with interrupts off by the thread that has just
+   acquired LOCK.  Records LOCK among the thread's held locks and
+   takes the donation of the highest-priority thread still
+   waiting for it. */
+static void
+take_donations(struct lock *lock)
 {
-  struct list_elem *e;
-  for (e = list_begin(&donation_list); e != list_end(&donation_list); e = list_next(e))
-  {
-    struct donation_log *log = list_entry(e, struct donation_log, don_elem);
-    if (log->donator == my_thread)
-      return log;
-  }
-  return NULL;
+  struct thread *cur = thread_current();
+  struct heap *waiters = &lock->semaphore.waiters;
+
+  lock->max_priority = PRI_MIN;
+  if (!heap_empty(waiters))
+    lock->max_priority = heap_entry(heap_front(waiters), struct thread,
+                                    waitelem)->priority;
+  list_push_back(&cur->held_locks, &lock->elem);
+  if (lock->max_priority > cur->priority)
+    cur->priority = lock->max_priority;
 }
 
-/* 用于将donation_log按序插入到donation_list中的比较函数 */
-bool less(struct list_elem *a, struct list_elem *b, void *aux)
+/* Returns the priority T should run at: its own priority, or
+   the highest priority donated to it through a lock it holds,
+   whichever is greater. */
+int donated_priority(struct thread *t)
 {
-  struct donation_log *log_a = list_entry(a, struct donation_log, don_elem);
-  struct donation_log *log_b = list_entry(b, struct donation_log, don_elem);
-  if (log_a->donator_pri <= log_b->donator_pri)
-    return false;
-  else
-    return true;
+  struct list_elem *e;
+  int pri = t->real_priority;
+
+  for (e = list_begin(&t->held_locks); e != list_end(&t->held_locks);
+       e = list_next(e))
+  {
+    struct lock *lock = list_entry(e, struct lock, elem);
+    if (lock->max_priority > pri)
+      pri = lock->max_priority;
+  }
+  return pri;
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -296,9 +405,22 @@ bool lock_try_acquire(struct lock *lock)
   ASSERT(lock != NULL);
   ASSERT(!lock_held_by_current_thread(lock));
 
+  enum intr_level old_level = intr_disable();
   success = sema_try_down(&lock->semaphore);
   if (success)
+  {
     lock->holder = thread_current();
+    if (!thread_mlfqs)
+      take_donations(lock);
+  }
+  intr_set_level(old_level);
+  if (success)
+    lock_acquired_stat(lock,
+                       lockstat_enabled
+                           ? lockstat_lookup(lock->semaphore.name,
+                                             __builtin_return_address(0), true)
+                           : NULL,
+                       false, 0);
   return success;
 }
 
@@ -312,93 +434,37 @@ void lock_release(struct lock *lock)
   ASSERT(lock != NULL);
   ASSERT(lock_held_by_current_thread(lock));
 
+  if (lock->stat != NULL)
+    lockstat_released(lock->stat, timer_now_ns() - lock->acquired_ns);
+
   enum intr_level old_level = intr_disable();
   if(!thread_mlfqs)
     refund_priority(lock);
   lock->holder = NULL;
   sema_up(&lock->semaphore);
-  free_donations();
   intr_set_level(old_level);
+  thread_preempt();
 }
 
-/* 
-  释放锁时归还优先级,释放完毕后将所有线程按优先级重排，
-  直接锁和递归锁的归还优先级逻辑不一样。
+/*
+  释放锁时归还优先级：把LOCK从当前线程持有的锁中去掉，
+  再根据剩下仍持有的锁重新计算当前线程的优先级。
  */
 void refund_priority(struct lock *lock)
 {
   enum intr_level old_level = intr_disable();
   struct thread *cur = thread_current();
-  struct donation_log *log;
+  int old_priority = cur->priority;
 
-  struct list_elem *e, *f;
-  bool exist_other_log = false;
-  bool cur_pri_should_change;
-  //由于free的过程中会thread_yield()，我们不能在free之前修改当前线程的优先级。用这个记录是否应该修改当前线程优先级。
-  int target_pri;
-  //用这个记录应该将当前线程的优先级调整为哪个数字
-
-  /* 分两种情况来思考：1.释放锁之前发生了优先级下调 ；2.释放锁之前未发生优先级下调 */
-  for (e = list_begin(&donation_list); e != list_end(&donation_list); e = list_next(e))
-  {
-    log = list_entry(e, struct donation_log, don_elem);
-    if (log->receiver == cur && log->mutex == lock)
-    {
-      struct thread *donator = log->donator;
-      if (log->donator_pri == cur->priority)
-      {
-        cur->priority = log->receiver_pri;
-        //如果是递归锁，那么此时不能动捐赠者的优先级，仅仅下调当前线程的优先级
-        if (!log->is_nest_donation)
-          donator->priority = log->donator_pri;
-
-        f = list_prev(e);
-        list_remove(e);
-        e = f;
-        list_push_back(&donation2delete, &log->don_elem);
-      }
-      else if (log->donator_pri < cur->priority)
-      {
-        if (log->is_nest_donation)
-          //证明donator曾参与过递归捐赠！
-          cur->priority = log->receiver_pri;
-        else
-          donator->priority = log->donator_pri;
-        f = list_prev(e);
-        list_remove(e);
-        e = f;
-        list_push_back(&donation2delete, &log->don_elem);
-      }
-    }
-    else if (log->receiver == cur && log->mutex != lock)
-      exist_other_log = true;
-  }
-  //此时锁已经放干净了！
-  //当不存在与该线程有关的其他捐赠记录，说明优先级应回到real_priority
-  if (!exist_other_log)
-    cur->priority = cur->real_priority;
-  //归还一部分优先级后，real_priority比priority高，说明归还前发生了优先级下调，且此时没有更高优先级的捐赠
-  if (cur->real_priority > cur->priority)
-    cur->priority = cur->real_priority;
+  list_remove(&lock->elem);
+  lock->max_priority = PRI_MIN;
+  cur->priority = donated_priority(cur);
+  if (cur->priority != old_priority)
+    SCHEDTRACE(PRIORITY, cur->tid, cur->priority, old_priority);
 
   intr_set_level(old_level);
 }
 
-/* 用于将已经废弃的捐赠记录释放内存 */
-void free_donations()
-{
-  struct list_elem *e, *f;
-  struct donation_log *log;
-  for (e = list_begin(&donation2delete); e != list_end(&donation2delete); e = list_next(e))
-  {
-    log = list_entry(e, struct donation_log, don_elem);
-    f = list_prev(e);
-    list_remove(e);
-    e = f;
-    free(log);
-  }
-}
-
 /* Returns true if the current thread holds LOCK, false
    otherwise.  (Note that testing whether some other thread holds
    a lock would be racy.) */
@@ -409,13 +475,6 @@ bool lock_held_by_current_thread(const struct lock *lock)
   return lock->holder == thread_current();
 }
 
-/* One semaphore in a list. */
-struct semaphore_elem
-{
-  struct list_elem elem;      /* List element. */
-  struct semaphore semaphore; /* This semaphore. */
-};
-
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
    code to receive the signal and act upon it. */
@@ -423,7 +482,7 @@ void cond_init(struct condition *cond)
 {
   ASSERT(cond != NULL);
 
-  list_init(&cond->waiters);
+  wait_queue_init(&cond->waiters);
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -448,26 +507,24 @@ void cond_init(struct condition *cond)
    we need to sleep. */
 void cond_wait(struct condition *cond, struct lock *lock)
 {
-  struct semaphore_elem waiter;
+  enum intr_level old_level;
 
   ASSERT(cond != NULL);
   ASSERT(lock != NULL);
   ASSERT(!intr_context());
   ASSERT(lock_held_by_current_thread(lock));
 
-  sema_init(&waiter.semaphore, 0);
-  list_push_ordered(&cond->waiters, &waiter.elem, 0);
-  //list_push_back(&cond->waiters, &waiter.elem);
+  /* The waiting thread itself sits in COND's queue.  Interrupts
+     stay off from queueing to blocking, so that releasing LOCK
+     cannot switch threads in between. */
+  old_level = intr_disable();
+  wait_queue_push(&cond->waiters);
   lock_release(lock);
-  sema_down(&waiter.semaphore);
+  thread_block(false);
+  intr_set_level(old_level);
   lock_acquire(lock);
 }
 
-bool cond_cmp(const struct list_elem *a, const struct list_elem *b, void *null)
-{
-  return list_entry((list_front(&list_entry(a, struct semaphore_elem, elem)->semaphore.waiters)), struct thread, elem)->priority > list_entry((list_front(&list_entry(b, struct semaphore_elem, elem)->semaphore.waiters)), struct thread, elem)->priority;
-}
-
 /* If any threads are waiting on COND (protected by LOCK), then
    this function signals one of them to wake up from its wait.
    LOCK must be held before calling this function.
@@ -483,13 +540,11 @@ void cond_signal(struct condition *cond, struct lock *lock UNUSED)
   ASSERT(!intr_context());
   ASSERT(lock_held_by_current_thread(lock));
 
-  if (!list_empty(&cond->waiters))
-  {
-    list_sort(&cond->waiters, cond_cmp, NULL); //make the list into ordered before wake
-    sema_up(&list_entry(list_pop_front(&cond->waiters),
-                        struct semaphore_elem, elem)
-                 ->semaphore);
-  }
+  enum intr_level old_level = intr_disable();
+  if (!heap_empty(&cond->waiters))
+    thread_unblock(wait_queue_pop(&cond->waiters));
+  intr_set_level(old_level);
+  thread_preempt();
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -503,6 +558,157 @@ void cond_broadcast(struct condition *cond, struct lock *lock)
   ASSERT(cond != NULL);
   ASSERT(lock != NULL);
 
-  while (!list_empty(&cond->waiters))
+  while (!heap_empty(&cond->waiters))
     cond_signal(cond, lock);
 }
+
+/* Initializes RWLOCK.  If PREFER_WRITERS is true, a writer
+   waiting for the lock keeps new readers out, so that a steady
+   stream of readers cannot starve it; otherwise readers are
+   admitted whenever no writer is active, which gives them the
+   best concurrency but may starve writers. */
+void rwlock_init(struct rwlock *rwlock, bool prefer_writers)
+{
+  ASSERT(rwlock != NULL);
+
+  lock_init(&rwlock->guard);
+  lock_init(&rwlock->write_lock);
+  cond_init(&rwlock->no_readers);
+  rwlock->readers = 0;
+  rwlock->writer = NULL;
+  rwlock->prefer_writers = prefer_writers;
+}
+
+/* Acquires RWLOCK for reading, sleeping until no writer holds it
+   (or, if it prefers writers, until no writer waits for it
+   either).  A reader waits for the writer by queuing on its
+   `write_lock', which donates the reader's priority to the
+   writer.  Read locks are not recursive when writers are
+   preferred.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void rwlock_acquire_read(struct rwlock *rwlock)
+{
+  ASSERT(rwlock != NULL);
+  ASSERT(!intr_context());
+
+  lock_acquire(&rwlock->guard);
+  while (rwlock->writer != NULL
+         || (rwlock->prefer_writers && rwlock->write_lock.holder != NULL))
+  {
+    lock_release(&rwlock->guard);
+    lock_acquire(&rwlock->write_lock);
+    lock_release(&rwlock->write_lock);
+    lock_acquire(&rwlock->guard);
+  }
+  rwlock->readers++;
+  lock_release(&rwlock->guard);
+}
+
+/* Releases RWLOCK, which the current thread must hold for
+   reading. */
+void rwlock_release_read(struct rwlock *rwlock)
+{
+  ASSERT(rwlock != NULL);
+
+  lock_acquire(&rwlock->guard);
+  ASSERT(rwlock->readers > 0);
+  if (--rwlock->readers == 0)
+    cond_signal(&rwlock->no_readers, &rwlock->guard);
+  lock_release(&rwlock->guard);
+}
+
+/* Acquires RWLOCK for writing, sleeping until no other thread
+   holds it.  Other writers are queued on `write_lock' and donate
+   their priority to the writer ahead of them; readers still
+   holding the lock are waited out on `no_readers'.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void rwlock_acquire_write(struct rwlock *rwlock)
+{
+  ASSERT(rwlock != NULL);
+  ASSERT(!intr_context());
+
+  lock_acquire(&rwlock->write_lock);
+  lock_acquire(&rwlock->guard);
+  while (rwlock->readers > 0)
+    cond_wait(&rwlock->no_readers, &rwlock->guard);
+  rwlock->writer = thread_current();
+  lock_release(&rwlock->guard);
+}
+
+/* Releases RWLOCK, which the current thread must hold for
+   writing. */
+void rwlock_release_write(struct rwlock *rwlock)
+{
+  ASSERT(rwlock != NULL);
+  ASSERT(rwlock->writer == thread_current());
+
+  lock_acquire(&rwlock->guard);
+  rwlock->writer = NULL;
+  lock_release(&rwlock->guard);
+  lock_release(&rwlock->write_lock);
+}
+
+/* Initializes SEQLOCK. */
+void seqlock_init(struct seqlock *seqlock)
+{
+  ASSERT(seqlock != NULL);
+
+  seqlock->seq = 0;
+  spinlock_init(&seqlock->lock);
+}
+
+/* Starts a read of the data protected by SEQLOCK and returns the
+   value to pass to seqlock_read_retry() once the data has been
+   copied out.  A typical reader looks like this:
+
+     do
+       {
+         start = seqlock_read_begin (&seqlock);
+         copy = data;
+       }
+     while (seqlock_read_retry (&seqlock, start));
+
+   May be called from an interrupt handler. */
+unsigned seqlock_read_begin(const struct seqlock *seqlock)
+{
+  unsigned seq = *(const volatile unsigned *)&seqlock->seq;
+  barrier();
+  return seq;
+}
+
+/* Returns true if the data read since the seqlock_read_begin()
+   call that returned START may be inconsistent, because a write
+   was in progress or has happened since, and so the read must be
+   retried. */
+bool seqlock_read_retry(const struct seqlock *seqlock, unsigned start)
+{
+  barrier();
+  return (start & 1) != 0
+         || *(const volatile unsigned *)&seqlock->seq != start;
+}
+
+/* Starts a write to the data protected by SEQLOCK.  Acquires
+   SEQLOCK's spinlock, which excludes all other writers, on this
+   CPU or any other, until the matching seqlock_write_end(), and
+   returns the previous interrupt level to pass to it. */
+enum intr_level seqlock_write_begin(struct seqlock *seqlock)
+{
+  enum intr_level old_level = spinlock_acquire(&seqlock->lock);
+
+  seqlock->seq++;
+  barrier();
+  return old_level;
+}
+
+/* Ends a write to the data protected by SEQLOCK, releasing its
+   spinlock and restoring interrupt level OLD_LEVEL. */
+void seqlock_write_end(struct seqlock *seqlock, enum intr_level old_level)
+{
+  barrier();
+  seqlock->seq++;
+  spinlock_release(&seqlock->lock, old_level);
+}
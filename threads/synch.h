@@ -1,18 +1,26 @@
 #ifndef THREADS_SYNCH_H
 #define THREADS_SYNCH_H
 
+#include <heap.h>
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include "threads/interrupt.h"
+#include "threads/spinlock.h"
 
 /* A counting semaphore. */
 struct semaphore
 {
   unsigned value;      /* Current value. */
-  struct list waiters; /* List of waiting threads. */
+  struct heap waiters; /* Waiting threads, by priority. */
+  const char *name;    /* Name, for lock statistics. */
 };
 
-void sema_init(struct semaphore *, unsigned value);
+/* sema_init() and lock_init() record the expression naming the
+   semaphore or lock, which identifies it in lockstat output. */
+#define sema_init(SEMA, VALUE) sema_init_named(SEMA, VALUE, #SEMA)
+void sema_init_named(struct semaphore *, unsigned value, const char *name);
 void sema_down(struct semaphore *);
 bool sema_try_down(struct semaphore *);
 void sema_up(struct semaphore *);
@@ -23,9 +31,14 @@ struct lock
 {
   struct thread *holder;      /* Thread holding lock (for debugging). */
   struct semaphore semaphore; /* Binary semaphore controlling access. */
+  struct list_elem elem;      /* Element in holder's `held_locks'. */
+  int max_priority;           /* Highest priority donated through this lock. */
+  struct lockstat_site *stat; /* Lock statistics of the holder's call site. */
+  int64_t acquired_ns;        /* When the holder acquired it, for lockstat. */
 };
 
-void lock_init(struct lock *);
+#define lock_init(LOCK) lock_init_named(LOCK, #LOCK)
+void lock_init_named(struct lock *, const char *name);
 void lock_acquire(struct lock *);
 bool lock_try_acquire(struct lock *);
 void lock_release(struct lock *);
@@ -34,7 +47,7 @@ bool lock_held_by_current_thread(const struct lock *);
 /* Condition variable. */
 struct condition
 {
-  struct list waiters; /* List of waiting threads. */
+  struct heap waiters; /* Waiting threads, by priority. */
 };
 
 void cond_init(struct condition *);
@@ -42,16 +55,56 @@ void cond_wait(struct condition *, struct lock *);
 void cond_signal(struct condition *, struct lock *);
 void cond_broadcast(struct condition *, struct lock *);
 
+/* Reader-writer lock.
+
+   Any number of readers, or a single writer, may hold it.  A
+   writer claims the lock by acquiring `write_lock', which it
+   keeps until it releases the rwlock, so that writers and
+   blocked readers queue on an ordinary lock and donate their
+   priority to the writer. */
+struct rwlock
+{
+  struct lock guard;           /* Protects the members below. */
+  struct lock write_lock;      /* Held by the writer, pending or active. */
+  struct condition no_readers; /* Signaled when `readers' drops to 0. */
+  unsigned readers;            /* Number of readers holding the lock. */
+  struct thread *writer;       /* Active writer, if any. */
+  bool prefer_writers;         /* Do pending writers block new readers? */
+};
+
+void rwlock_init(struct rwlock *, bool prefer_writers);
+void rwlock_acquire_read(struct rwlock *);
+void rwlock_release_read(struct rwlock *);
+void rwlock_acquire_write(struct rwlock *);
+void rwlock_release_write(struct rwlock *);
+
+/* Sequence lock.
+
+   Protects small, read-mostly data that readers copy out, such
+   as a 64-bit counter that cannot be read atomically.  Readers
+   never block: they retry if a write intervened.  Writers are
+   serialized by a spinlock, which also turns interrupts off, so
+   a seqlock may be written and read from interrupt handlers and
+   from any CPU. */
+struct seqlock
+{
+  unsigned seq;         /* Odd while a write is in progress. */
+  struct spinlock lock; /* Serializes writers. */
+};
+
+void seqlock_init(struct seqlock *);
+unsigned seqlock_read_begin(const struct seqlock *);
+bool seqlock_read_retry(const struct seqlock *, unsigned start);
+enum intr_level seqlock_write_begin(struct seqlock *);
+void seqlock_write_end(struct seqlock *, enum intr_level);
+
 /* 新函数声明 */
 void donate_priority(struct lock *);
 
 void refund_priority(struct lock *);
 
-void free_donations();
-
-bool less(struct list_elem *a, struct list_elem *b, void *aux);
-
-struct donation_log *find_donation_log(struct thread *);
+struct thread;
+int donated_priority(struct thread *);
 
 /* Optimization barrier.
 
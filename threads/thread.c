@@ -2,16 +2,21 @@
 #include <debug.h>
 #include <stddef.h>
 #include <random.h>
+#include <round.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
 #include "threads/palloc.h"
+#include "threads/schedtrace.h"
+#include "threads/spinlock.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 #include "devices/timer.h"
+#include "devices/tsc.h"
 //TODO:增加fp库
 #include "devices/fixed-point.h"
 #ifdef USERPROG
@@ -23,24 +28,51 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Run queue of processes in THREAD_READY state, that is,
+   processes that are ready to run but not actually running.
+
+   There is one FIFO queue per priority.  Bit P of ready_bitmap
+   is set if and only if ready_queues[P] is nonempty, so the
+   highest-priority ready thread is found with a single bit scan
+   instead of walking a sorted list.  All of these are protected
+   by disabling interrupts. */
+static struct list ready_queues[PRI_MAX + 1];
+static uint64_t ready_bitmap;
+static size_t ready_cnt; /* Number of threads ready to run. */
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
 static struct list all_list;
 
-static struct list sleep_list;
-
-/* Idle thread. */
-static struct thread *idle_thread;
+/* Threads sleeping in timer_sleep(), in a heap ordered by
+   sleep_end, so that the next thread due is always at the front.
+   Insertion takes constant time, and each timer tick removes only
+   the threads that are due, in O(log n) amortized time apiece;
+   threads that are not yet due are never looked at.  Protected
+   by disabling interrupts. */
+static struct heap sleep_queue;
+static int64_t sleep_queue_tick; /* Last tick woken up to. */
 
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
 
-/* Lock used by allocate_tid(). */
-static struct lock tid_lock;
+/* Cache of pages of dead threads, reused for new threads.
+
+   The most recently freed page is reused first, since it is the
+   most likely to still be in the CPU cache.  A reused page need
+   not be zeroed: init_thread() clears `struct thread' and the
+   rest is stack. */
+#define THREAD_CACHE_MAX 8
+struct cached_page
+{
+  struct cached_page *next; /* Next cached page. */
+};
+static struct spinlock thread_cache_lock;
+static struct cached_page *thread_cache;
+static int thread_cache_cnt;
+
+static struct thread *alloc_thread_page(void);
+static void free_thread_page(struct thread *);
 
 /* Stack frame for kernel_thread(). */
 struct kernel_thread_frame
@@ -50,23 +82,96 @@ struct kernel_thread_frame
   void *aux;             /* Auxiliary data for function. */
 };
 
-/* Statistics. */
-static long long idle_ticks;   /* # of timer ticks spent idle. */
-static long long kernel_ticks; /* # of timer ticks in kernel threads. */
-static long long user_ticks;   /* # of timer ticks in user programs. */
-
-/* Scheduling. */
+/* Scheduling.  The idle thread, tick statistics and the running
+   thread's time slice are per CPU, in struct cpu. */
 #define TIME_SLICE 4          /* # of timer ticks to give each thread. */
-static unsigned thread_ticks; /* # of timer ticks since last yield. */
 
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* If true, use the proportional-share scheduler instead of
+   either of the above.  Controlled by kernel command-line option
+   "-sched=fair". */
+bool thread_fair;
+
+/* If true, thread_print_stats() also prints the per-thread time
+   table.  Controlled by kernel command-line option
+   "-threadstat". */
+bool thread_print_times;
+
+/* Proportional-share scheduling.
+
+   Each thread accumulates virtual runtime: the CPU time it used,
+   scaled by FAIR_WEIGHT_NICE_0 / its weight, so that threads
+   with larger weights (lower nice values) age more slowly.  The
+   ready threads are kept in a heap ordered by virtual runtime,
+   and the one that has had the least runs next.  Over time each
+   CPU-bound thread gets a share of the CPU proportional to its
+   weight. */
+static struct heap fair_queue;
+
+/* Smallest virtual runtime of any runnable thread, in ns; never
+   decreases.  New and woken threads are placed relative to it. */
+static int64_t fair_min_vruntime;
+
+/* A running thread is preempted once its virtual runtime exceeds
+   that of the front ready thread by this much, in ns. */
+#define FAIR_GRANULARITY (TIME_SLICE * (1000000000 / TIMER_FREQ) / 2)
+
+/* Weight of a nice-0 thread. */
+#define FAIR_WEIGHT_NICE_0 1024
+
+/* Weights for nice values NICE_MIN through NICE_MAX.  Each step
+   in nice changes a thread's share by about 25% relative to a
+   thread one step away; these are the weights Linux uses. */
+static const int fair_weights[NICE_MAX - NICE_MIN + 1] = {
+    /* -20 */ 88761, 71755, 56483, 46273, 36291,
+    /* -15 */ 29154, 23254, 18705, 14949, 11916,
+    /* -10 */ 9548, 7620, 6100, 4904, 3906,
+    /*  -5 */ 3121, 2501, 1991, 1586, 1277,
+    /*   0 */ 1024, 820, 655, 526, 423,
+    /*   5 */ 335, 272, 215, 172, 137,
+    /*  10 */ 110, 87, 70, 56, 45,
+    /*  15 */ 36, 29, 23, 18, 15,
+    /*  20 */ 12,
+};
+
+/* Real-time scheduling class.
+
+   A real-time thread, created by thread_create_rt(), may run
+   for up to `rt_budget' ticks in each period of `rt_period'
+   ticks.  Ready real-time threads are kept in a heap ordered by
+   the end of their current period, their deadline, and always
+   run ahead of other threads, earliest deadline first.  A
+   thread that uses up its budget is throttled: it is kept off
+   the run queue, on `rt_throttled', until its next period
+   begins.
+
+   Admission control keeps the total utilization of real-time
+   threads, the sum of budget / period, at or below RT_UTIL_MAX
+   out of RT_UTIL_SCALE.  Under that bound EDF meets every
+   deadline, and the rest of the CPU is left for other threads. */
+static struct heap rt_queue;
+static struct list rt_throttled;
+static int rt_utilization;      /* Admitted utilization, of RT_UTIL_SCALE. */
+static long long rt_throttles;  /* # of times a thread ran out of budget. */
+#define RT_UTIL_SCALE 1000
+#define RT_UTIL_MAX 900
+
 //TODO:添加了全局变量load_avg(考虑到涉及浮点数运算，应为fp)
 fp load_avg;
 
+/* MLFQS bookkeeping.  mlfqs_epoch counts the once-per-second
+   recent_cpu updates, and decay_history[] keeps the decay
+   coefficient used at each of the last MLFQS_HISTORY of them,
+   indexed by epoch modulo MLFQS_HISTORY, so that blocked threads
+   can be brought up to date lazily when they wake up. */
+#define MLFQS_HISTORY 64
+static int mlfqs_epoch;
+static fp decay_history[MLFQS_HISTORY];
+
 static void kernel_thread(thread_func *, void *aux);
 
 static void idle(void *aux UNUSED);
@@ -78,6 +183,35 @@ static void *alloc_frame(struct thread *, size_t size);
 static void schedule(void);
 void thread_schedule_tail(struct thread *prev);
 static tid_t allocate_tid(void);
+static void ready_queue_push(struct thread *);
+static void ready_queue_remove(struct thread *);
+static struct thread *ready_queue_pop(void);
+static inline int highest_bit(uint64_t);
+static void mlfqs_catch_up(struct thread *);
+static bool sleep_queue_insert(struct thread *);
+static bool sleep_less(const struct heap_elem *, const struct heap_elem *,
+                       void *);
+static bool ready_queue_preempts(struct thread *);
+static inline uint64_t thread_clock(void);
+static void account_state(struct thread *, enum thread_status, uint64_t now);
+static unsigned long long cycles_to_ms(uint64_t);
+struct thread_times;
+static void get_thread_times(const struct thread *, struct thread_times *);
+static void sum_run_time(struct thread *, void *);
+static void print_thread_times(struct thread *, void *);
+static bool fair_less(const struct heap_elem *, const struct heap_elem *,
+                      void *);
+static void fair_account(struct thread *);
+static void fair_place(struct thread *);
+static tid_t create_thread(const char *name, int priority,
+                           thread_func *, void *aux,
+                           int64_t period, int64_t budget);
+static inline bool is_rt(const struct thread *);
+static int rt_util(int64_t period, int64_t budget);
+static bool rt_less(const struct heap_elem *, const struct heap_elem *,
+                    void *);
+static void rt_new_period(struct thread *, int64_t now);
+static void rt_replenish(int64_t now);
 
 
 //创建主线程 暂时不确定load_avg需要在thread_init or start开始 在开始调度比较合理（准备运行的平均线程数
@@ -96,14 +230,19 @@ static tid_t allocate_tid(void);
    finishes. */
 void thread_init(void)
 {
+  int pri;
+
   ASSERT(intr_get_level() == INTR_OFF);
 
-  lock_init(&tid_lock);
-  list_init(&ready_list);
+  for (pri = PRI_MIN; pri <= PRI_MAX; pri++)
+    list_init(&ready_queues[pri]);
+  ready_bitmap = 0;
+  heap_init(&fair_queue, fair_less, NULL);
+  heap_init(&rt_queue, rt_less, NULL);
+  spinlock_init(&thread_cache_lock);
+  list_init(&rt_throttled);
   list_init(&all_list);
-  list_init(&sleep_list);
-  list_init(&donation_list);
-  list_init(&donation2delete);
+  heap_init(&sleep_queue, sleep_less, NULL);
 
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread();
@@ -125,9 +264,9 @@ void thread_start(void)
   intr_enable();
 
   //TODO：初始化系统平均负载
-  load_avg = INT_TO_FP(0);
+  load_avg = fp_from_int(0);
 
-  /* Wait for the idle thread to initialize idle_thread. */
+  /* Wait for the idle thread to initialize cpu_current()->idle. */
   sema_down(&idle_started);
 }
 
@@ -135,28 +274,141 @@ void thread_start(void)
    Thus, this function runs in an external interrupt context. */
 void thread_tick(void)
 {
+  struct cpu *c = cpu_current();
   struct thread *t = thread_current();
 
   /* Update statistics. */
-  if (t == idle_thread)
-    idle_ticks++;
+  if (t == c->idle)
+    c->idle_ticks++;
 #ifdef USERPROG
   else if (t->pagedir != NULL)
-    user_ticks++;
+    c->user_ticks++;
 #endif
   else
-    kernel_ticks++;
+    c->kernel_ticks++;
 
   /* Enforce preemption. */
-  if (++thread_ticks >= TIME_SLICE)
+  rt_replenish(timer_ticks());
+  if (is_rt(t))
+  {
+    if (--t->rt_remaining <= 0)
+    {
+      t->rt_throttled = true;
+      rt_throttles++;
+      intr_yield_on_return();
+    }
+    else if (ready_queue_preempts(t))
+      intr_yield_on_return();
+  }
+  else if (thread_fair)
+  {
+    fair_account(t);
+    if (ready_queue_preempts(t))
+      intr_yield_on_return();
+  }
+  else if (++c->thread_ticks >= TIME_SLICE)
     intr_yield_on_return();
 }
 
+/* Accounts for CNT timer ticks that the idle thread spent with
+   the periodic tick stopped.  Called from the timer interrupt. */
+void thread_tick_suppressed(int64_t cnt)
+{
+  cpu_current()->idle_ticks += cnt;
+}
+
 /* Prints thread statistics. */
 void thread_print_stats(void)
 {
+  long long idle_ticks = 0, kernel_ticks = 0, user_ticks = 0;
+  int i;
+
+  for (i = 0; i < cpu_cnt; i++)
+  {
+    idle_ticks += cpus[i].idle_ticks;
+    kernel_ticks += cpus[i].kernel_ticks;
+    user_ticks += cpus[i].user_ticks;
+  }
   printf("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
          idle_ticks, kernel_ticks, user_ticks);
+  if (rt_throttles > 0)
+    printf("Thread: %lld real-time budget overruns\n", rt_throttles);
+  if (thread_print_times)
+    thread_print_table();
+}
+
+/* Per-thread statistics for thread_print_table(), as of `now'. */
+struct thread_times
+{
+  uint64_t now;          /* TSC value when the table was taken. */
+  uint64_t run;          /* Total run time of all threads, in cycles. */
+  uint64_t run_cycles;   /* Times of one thread, in cycles. */
+  uint64_t wait_cycles;
+  uint64_t block_cycles;
+};
+
+/* Prints a table of every thread's CPU time, time spent ready
+   but waiting for the CPU, and time blocked, with its share of
+   the total run time and its context switch counts.  Times are
+   measured with the TSC, so they read as zero on CPUs without
+   one. */
+void thread_print_table(void)
+{
+  struct thread_times tt;
+  enum intr_level old_level = intr_disable();
+
+  tt.now = thread_clock();
+  tt.run = 0;
+  thread_foreach(sum_run_time, &tt);
+  printf("  TID NAME             STATE   PRI NICE    RUN(ms)   WAIT(ms)"
+         "  BLOCK(ms)   %%CPU   VCSW  IVCSW\n");
+  thread_foreach(print_thread_times, &tt);
+  intr_set_level(old_level);
+}
+
+/* Stores T's times as of TT->now in TT, including the time since
+   its last state change. */
+static void
+get_thread_times(const struct thread *t, struct thread_times *tt)
+{
+  uint64_t pending = t->state_tsc != 0 ? tt->now - t->state_tsc : 0;
+
+  tt->run_cycles = t->run_cycles;
+  tt->wait_cycles = t->wait_cycles;
+  tt->block_cycles = t->block_cycles;
+  if (t->status == THREAD_RUNNING)
+    tt->run_cycles += pending;
+  else if (t->status == THREAD_READY)
+    tt->wait_cycles += pending;
+  else if (t->status == THREAD_BLOCKED)
+    tt->block_cycles += pending;
+}
+
+/* Adds T's run time to TT_'s total. */
+static void
+sum_run_time(struct thread *t, void *tt_)
+{
+  struct thread_times *tt = tt_;
+
+  get_thread_times(t, tt);
+  tt->run += tt->run_cycles;
+}
+
+/* Prints T's row of the thread table. */
+static void
+print_thread_times(struct thread *t, void *tt_)
+{
+  static const char *status_names[] = {"run", "ready", "blocked", "dying"};
+  struct thread_times *tt = tt_;
+  unsigned permille;
+
+  get_thread_times(t, tt);
+  permille = tt->run > 0 ? tt->run_cycles * 1000 / tt->run : 0;
+  printf("%5d %-16s %-7s %3d %4d %10llu %10llu %10llu %4u.%u%% %6u %6u\n",
+         t->tid, t->name, status_names[t->status], t->priority, t->nice,
+         cycles_to_ms(tt->run_cycles), cycles_to_ms(tt->wait_cycles),
+         cycles_to_ms(tt->block_cycles), permille / 10, permille % 10,
+         t->nvcsw, t->nivcsw);
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -176,6 +428,54 @@ void thread_print_stats(void)
    Priority scheduling is the goal of Problem 1-3. */
 tid_t thread_create(const char *name, int priority,
                     thread_func *function, void *aux)
+{
+  return create_thread(name, priority, function, aux, 0, 0);
+}
+
+/* Creates a new real-time kernel thread named NAME, which
+   executes FUNCTION passing AUX as the argument, and adds it to
+   the ready queue.  The thread may use up to BUDGET timer ticks
+   of CPU time in each PERIOD ticks; it is scheduled ahead of
+   all other threads, earliest deadline first, and throttled
+   until its next period once its budget runs out.  Returns the
+   thread identifier for the new thread, or TID_ERROR if creation
+   fails or admitting the thread would overcommit the CPU.
+
+   The thread runs at priority PRI_MAX, which is what it donates
+   to the holders of locks it waits for. */
+tid_t thread_create_rt(const char *name, int64_t period, int64_t budget,
+                       thread_func *function, void *aux)
+{
+  int util = rt_util(period, budget);
+  enum intr_level old_level;
+  tid_t tid;
+
+  ASSERT(0 < budget && budget <= period);
+
+  old_level = intr_disable();
+  if (rt_utilization + util > RT_UTIL_MAX)
+  {
+    intr_set_level(old_level);
+    return TID_ERROR;
+  }
+  rt_utilization += util;
+  intr_set_level(old_level);
+
+  tid = create_thread(name, PRI_MAX, function, aux, period, budget);
+  if (tid == TID_ERROR)
+  {
+    old_level = intr_disable();
+    rt_utilization -= util;
+    intr_set_level(old_level);
+  }
+  return tid;
+}
+
+/* Does the work of thread_create() and thread_create_rt().  The
+   new thread is real-time if PERIOD is nonzero. */
+static tid_t
+create_thread(const char *name, int priority, thread_func *function,
+              void *aux, int64_t period, int64_t budget)
 {
   struct thread *t;
   struct kernel_thread_frame *kf;
@@ -187,13 +487,15 @@ tid_t thread_create(const char *name, int priority,
   ASSERT(function != NULL);
 
   /* Allocate thread. */
-  t = palloc_get_page(PAL_ZERO);
+  t = alloc_thread_page();
   if (t == NULL)
     return TID_ERROR;
 
   /* Initialize thread. */
   init_thread(t, name, priority);
   tid = t->tid = allocate_tid();
+  t->rt_period = period;
+  t->rt_budget = budget;
 
   /* Prepare thread for first run by initializing its stack.
      Do this atomically so intermediate values for the 'stack' 
@@ -237,31 +539,13 @@ void thread_block(bool timer_sleep)
   ASSERT(!intr_context());
   ASSERT(intr_get_level() == INTR_OFF);
 
-  struct list_elem *e;
-
-  if (timer_sleep)//若该线程被定时器休眠
-  {
-    if (list_empty(&sleep_list))
-      list_push_front(&sleep_list, &thread_current()->sleepelem);
-
-    else
-    {
-      int has_inserted = 0;
-      for (e = list_begin(&sleep_list); e != list_end(&sleep_list); e = list_next(e))
-      {
-        struct thread *thread = list_entry(e, struct thread, sleepelem);
-        if (thread_current()->sleep_end <= thread->sleep_end)
-        {
-          list_insert(&thread->sleepelem, &thread_current()->sleepelem);
-          has_inserted = 1;
-          break;
-        }
-      }
-      if (has_inserted == 0)
-        list_push_back(&sleep_list, &thread_current()->sleepelem);
-    }
-  }
+  /* 若该线程被定时器休眠.  If its wake-up tick has already been
+     expired, it is due now and must not block. */
+  if (timer_sleep && !sleep_queue_insert(thread_current()))
+    return;
 
+  SCHEDTRACE(BLOCK, thread_current()->tid, thread_current()->priority,
+             timer_sleep ? SCHEDTRACE_BLOCK_SLEEP : SCHEDTRACE_BLOCK_WAIT);
   thread_current()->status = THREAD_BLOCKED;
   schedule();
 }
@@ -282,9 +566,22 @@ void thread_unblock(struct thread *t)
 
   old_level = intr_disable();
   ASSERT(t->status == THREAD_BLOCKED);
-  list_push_ordered(&ready_list, &t->elem, t->priority);
-  //按优先级插入队列
+  if (is_rt(t))
+  {
+    /* A thread that waited past its deadline starts a new
+       period; one that woke earlier continues the current one. */
+    int64_t now = timer_ticks();
+    if (now >= t->rt_deadline)
+      rt_new_period(t, now);
+  }
+  else if (thread_mlfqs)
+    mlfqs_catch_up(t);
+  else if (thread_fair)
+    fair_place(t);
+  account_state(t, THREAD_BLOCKED, thread_clock());
+  ready_queue_push(t);
   t->status = THREAD_READY;
+  SCHEDTRACE(WAKEUP, t->tid, t->priority, running_thread()->tid);
   intr_set_level(old_level);
 }
 
@@ -329,11 +626,15 @@ void thread_exit(void)
 #ifdef USERPROG
   process_exit();
 #endif
+  malloc_thread_exit();
 
   /* Remove thread from all threads list, set our status to dying,
      and schedule another process.  That process will destroy us
      when it calls thread_schedule_tail(). */
   intr_disable();
+  if (is_rt(thread_current()))
+    rt_utilization -= rt_util(thread_current()->rt_period,
+                              thread_current()->rt_budget);
   list_remove(&thread_current()->allelem);
   thread_current()->status = THREAD_DYING;
   schedule();
@@ -350,14 +651,35 @@ void thread_yield(void)
   ASSERT(!intr_context());
 
   old_level = intr_disable();
-  if (cur != idle_thread)
-    list_push_ordered(&ready_list, &cur->elem, cur->priority);
-  //list_push_back(&ready_list, &cur->elem);
+  if (thread_fair)
+    fair_account(cur);
+  if (cur != cpu_current()->idle)
+    ready_queue_push(cur);
   cur->status = THREAD_READY;
   schedule();
   intr_set_level(old_level);
 }
 
+/* Yields the CPU if a ready thread has a higher priority than
+   the running thread.  Called after waking up a thread.  Within
+   an interrupt handler the yield happens on return from the
+   interrupt; if interrupts are off, the caller is in an atomic
+   section and the running thread keeps the CPU until it turns
+   them back on and calls this function again. */
+void thread_preempt(void)
+{
+  enum intr_level old_level = intr_disable();
+  bool preempt = ready_queue_preempts(thread_current());
+  intr_set_level(old_level);
+
+  if (!preempt)
+    return;
+  if (intr_context())
+    intr_yield_on_return();
+  else if (old_level == INTR_ON)
+    thread_yield();
+}
+
 /* Invoke function 'func' on all threads, passing along 'aux'.
    This function must be called with interrupts off. */
 void thread_foreach(thread_action_func *func, void *aux)
@@ -376,29 +698,22 @@ void thread_foreach(thread_action_func *func, void *aux)
 
 /* 
   Sets the current thread's priority to NEW_PRIORITY. 
-  这个函数不能总是生效！！！当new_priority小于当前priority，且线程处于被捐赠状态，需要屏蔽此次优先级修改
+  被捐赠期间只修改real_priority，实际优先级仍取捐赠和real_priority中较大者；
+  优先级下调后需要出让cpu
 */
 void thread_set_priority(int new_priority)
 {
   struct thread *cur = thread_current();
-  if (new_priority >= cur->priority)
-  {
-    cur->priority = new_priority;
-    cur->real_priority = new_priority;
-  }
-  else
-  {
-    if (cur->priority > cur->real_priority)
-    { //说明处于被捐赠状态
-      cur->real_priority = new_priority;
-    }
-    else
-    { //未处于捐赠状态且优先级下调，需要出让cpu
-      cur->priority = new_priority;
-      cur->real_priority = new_priority;
-      thread_yield();
-    }
-  }
+  enum intr_level old_level = intr_disable();
+  int old_priority = cur->priority;
+
+  cur->real_priority = new_priority;
+  cur->priority = donated_priority(cur);
+  if (cur->priority != old_priority)
+    SCHEDTRACE(PRIORITY, cur->tid, cur->priority, old_priority);
+  intr_set_level(old_level);
+  if (cur->priority < old_priority)
+    thread_yield();
 }
 
 /* Returns the current thread's priority. */
@@ -421,8 +736,8 @@ int thread_get_real_priority(void)
 void thread_set_nice(int nice )
 {
   
-  thread_current()->nice= nice > NICE_MAX ? NICE_MAX : nice;
-  thread_current()->nice = nice < NICE_MIN ? NICE_MIN : nice;
+  nice = nice > NICE_MAX ? NICE_MAX : nice;
+  nice = nice < NICE_MIN ? NICE_MIN : nice;
   thread_current()->nice = nice;
   //重新计算优先级 待补充
   // update_priority_single(thread_current());
@@ -445,8 +760,7 @@ int thread_get_nice(void)
 /* Returns 100 times the system load average. */
 int thread_get_load_avg(void)
 {
-  fp tmpfp = MULTI_FP_INT(load_avg,100);
-  return FP_TO_INT_NEAREST(tmpfp);
+  return fp_round_scaled(load_avg, 100);
 
 }
 
@@ -455,9 +769,7 @@ int thread_get_recent_cpu(void)
 {
   /* Not yet implemented. */
   // return 0;
-  fp cur_cpu_fp = thread_current()->recent_cpu;
-  fp cpu_multi = MULTI_FP_INT(cur_cpu_fp,100);
-  return FP_TO_INT_NEAREST(cpu_multi); 
+  return fp_round_scaled(thread_current()->recent_cpu, 100);
 }
 
 
@@ -466,23 +778,27 @@ int thread_get_recent_cpu(void)
 
    The idle thread is initially put on the ready list by
    thread_start().  It will be scheduled once initially, at which
-   point it initializes idle_thread, "up"s the semaphore passed
-   to it to enable thread_start() to continue, and immediately
-   blocks.  After that, the idle thread never appears in the
+   point it records itself as its CPU's idle thread, "up"s the
+   semaphore passed to it to enable thread_start() to continue,
+   and immediately blocks.  After that, the idle thread never appears in the
    ready list.  It is returned by next_thread_to_run() as a
    special case when the ready list is empty. */
 static void
 idle(void *idle_started_ UNUSED)
 {
   struct semaphore *idle_started = idle_started_;
-  idle_thread = thread_current();
+  cpu_current()->idle = thread_current();
   sema_up(idle_started);
 
   for (;;)
   {
+    /* Prepare zeroed pages while there is nothing else to do. */
+    palloc_zero_idle();
+
     /* Let someone else run. */
     intr_disable();
     thread_block(false);
+    timer_idle_enter();
 
     /* Re-enable interrupts and wait for the next one.
 
@@ -496,6 +812,7 @@ idle(void *idle_started_ UNUSED)
 
          See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
          7.11.1 "HLT Instruction". */
+    intr_note_enable();
     asm volatile("sti; hlt"
                  :
                  :
@@ -553,12 +870,15 @@ init_thread(struct thread *t, const char *name, int priority)
   t->stack = (uint8_t *)t + PGSIZE;
   t->priority = priority;
   t->real_priority = priority;
+  list_init(&t->held_locks);
   //TODO:INITIALIZED 初始化
   t->nice = 0;
-  t->recent_cpu = INT_TO_FP(0);
+  t->recent_cpu = fp_from_int(0);
+  t->mlfqs_epoch = mlfqs_epoch;
+  t->vruntime = fair_min_vruntime;
+  t->state_tsc = thread_clock();
   t->magic = THREAD_MAGIC;
-  list_push_ordered(&all_list, &t->allelem, priority);
-  //list_push_back(&all_list, &t->allelem);
+  list_push_back(&all_list, &t->allelem);
 }
 
 /* Allocates a SIZE-byte frame at the top of thread T's stack and
@@ -578,14 +898,301 @@ alloc_frame(struct thread *t, size_t size)
    return a thread from the run queue, unless the run queue is
    empty.  (If the running thread can continue running, then it
    will be in the run queue.)  If the run queue is empty, return
-   idle_thread. */
+   the CPU's idle thread. */
 struct thread *
 next_thread_to_run(void)
 {
-  if (list_empty(&ready_list))
-    return idle_thread;
+  struct thread *next = ready_queue_pop();
+  return next != NULL ? next : cpu_current()->idle;
+}
+
+/* Returns the index of the most significant set bit in X,
+   which must be nonzero.  See [IA32-v2a] "BSR". */
+static inline int
+highest_bit(uint64_t x)
+{
+  uint32_t hi = x >> 32, lo = x;
+  uint32_t idx;
+
+  ASSERT(x != 0);
+  if (hi != 0)
+  {
+    asm("bsrl %1, %0"
+        : "=r"(idx)
+        : "rm"(hi));
+    return idx + 32;
+  }
+  asm("bsrl %1, %0"
+      : "=r"(idx)
+      : "rm"(lo));
+  return idx;
+}
+
+/* Appends T to the run queue for its current priority.
+   Interrupts must be off. */
+static void
+ready_queue_push(struct thread *t)
+{
+  ASSERT(intr_get_level() == INTR_OFF);
+  ASSERT(PRI_MIN <= t->priority && t->priority <= PRI_MAX);
+
+  if (is_rt(t) && t->rt_throttled)
+  {
+    list_push_back(&rt_throttled, &t->elem);
+    return;
+  }
+  ready_cnt++;
+  if (is_rt(t))
+  {
+    heap_insert(&rt_queue, &t->rtelem);
+    return;
+  }
+  if (thread_fair)
+  {
+    heap_insert(&fair_queue, &t->fairelem);
+    return;
+  }
+  t->ready_pri = t->priority;
+  list_push_back(&ready_queues[t->ready_pri], &t->elem);
+  ready_bitmap |= (uint64_t)1 << t->ready_pri;
+}
+
+/* Removes T, which must be in the run queue, from it.
+   Interrupts must be off. */
+static void
+ready_queue_remove(struct thread *t)
+{
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (is_rt(t) && t->rt_throttled)
+  {
+    list_remove(&t->elem);
+    return;
+  }
+  ready_cnt--;
+  if (is_rt(t))
+  {
+    heap_remove(&rt_queue, &t->rtelem);
+    return;
+  }
+  if (thread_fair)
+  {
+    heap_remove(&fair_queue, &t->fairelem);
+    return;
+  }
+  list_remove(&t->elem);
+  if (list_empty(&ready_queues[t->ready_pri]))
+    ready_bitmap &= ~((uint64_t)1 << t->ready_pri);
+}
+
+/* Removes and returns the real-time thread with the earliest
+   deadline, if any, otherwise the next thread chosen by the
+   scheduler in use, or a null pointer if no thread is ready.
+   Interrupts must be off. */
+static struct thread *
+ready_queue_pop(void)
+{
+  struct thread *t;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (!heap_empty(&rt_queue))
+    t = heap_entry(heap_front(&rt_queue), struct thread, rtelem);
+  else if (thread_fair)
+  {
+    if (heap_empty(&fair_queue))
+      return NULL;
+    t = heap_entry(heap_front(&fair_queue), struct thread, fairelem);
+    if (t->vruntime > fair_min_vruntime)
+      fair_min_vruntime = t->vruntime;
+  }
   else
-    return list_entry(list_pop_front(&ready_list), struct thread, elem);
+  {
+    if (ready_bitmap == 0)
+      return NULL;
+    t = list_entry(list_front(&ready_queues[highest_bit(ready_bitmap)]),
+                   struct thread, elem);
+  }
+  ready_queue_remove(t);
+  return t;
+}
+
+/* Returns true if a ready thread should preempt CUR, the running
+   thread: a real-time thread, if CUR is not one or has a later
+   deadline; otherwise, under priority scheduling and the MLFQS,
+   a ready thread of higher priority, and under the fair
+   scheduler, one whose virtual runtime is behind CUR's by more
+   than the granularity.  Interrupts must be off. */
+static bool
+ready_queue_preempts(struct thread *cur)
+{
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (!heap_empty(&rt_queue))
+  {
+    struct thread *front
+        = heap_entry(heap_front(&rt_queue), struct thread, rtelem);
+    return !is_rt(cur) || front->rt_deadline < cur->rt_deadline;
+  }
+  if (is_rt(cur))
+    return false;
+  if (thread_fair)
+  {
+    struct thread *front;
+
+    if (heap_empty(&fair_queue))
+      return false;
+    if (cur == cpu_current()->idle)
+      return true;
+    front = heap_entry(heap_front(&fair_queue), struct thread, fairelem);
+    return front->vruntime + FAIR_GRANULARITY < cur->vruntime;
+  }
+  return ready_bitmap != 0 && highest_bit(ready_bitmap) > cur->priority;
+}
+
+/* Orders threads in the fair run queue by virtual runtime. */
+static bool
+fair_less(const struct heap_elem *a_, const struct heap_elem *b_,
+          void *aux UNUSED)
+{
+  const struct thread *a = heap_entry(a_, struct thread, fairelem);
+  const struct thread *b = heap_entry(b_, struct thread, fairelem);
+
+  return a->vruntime < b->vruntime;
+}
+
+/* Charges the running thread T for the CPU time it has used since
+   it was last charged, in virtual runtime. */
+static void
+fair_account(struct thread *t)
+{
+  int64_t now = timer_now_ns();
+  int64_t delta = now - t->exec_start;
+
+  t->exec_start = now;
+  if (delta <= 0)
+    return;
+  if (t != cpu_current()->idle)
+    t->vruntime += delta * FAIR_WEIGHT_NICE_0
+                   / fair_weights[t->nice - NICE_MIN];
+}
+
+/* Places T, which is waking up, in virtual time.  A thread that
+   slept keeps its virtual runtime, but no less than half a
+   granularity behind the queue, so that a long sleep does not
+   let it monopolize the CPU afterward. */
+static void
+fair_place(struct thread *t)
+{
+  int64_t floor = fair_min_vruntime - FAIR_GRANULARITY / 2;
+
+  if (t->vruntime < floor)
+    t->vruntime = floor;
+}
+
+/* Returns the clock used for per-thread time accounting: the
+   TSC, or 0 if the CPU has none or it has not been detected yet,
+   which makes account_state() skip the interval. */
+static inline uint64_t
+thread_clock(void)
+{
+  return tsc_present() ? rdtsc() : 0;
+}
+
+/* Charges the time since T last changed state, which it spent
+   in state STATUS, to the matching counter in T, as of clock
+   value NOW, and restarts the interval. */
+static void
+account_state(struct thread *t, enum thread_status status, uint64_t now)
+{
+  uint64_t delta = t->state_tsc != 0 && now != 0 ? now - t->state_tsc : 0;
+
+  t->state_tsc = now;
+  if (status == THREAD_RUNNING)
+    t->run_cycles += delta;
+  else if (status == THREAD_READY)
+    t->wait_cycles += delta;
+  else if (status == THREAD_BLOCKED)
+    t->block_cycles += delta;
+}
+
+/* Converts CYCLES of the TSC to milliseconds, or returns 0 if
+   the TSC has not been calibrated. */
+static unsigned long long
+cycles_to_ms(uint64_t cycles)
+{
+  return tsc_calibrated() ? tsc_to_ns(cycles) / 1000000 : 0;
+}
+
+/* Returns true if T belongs to the real-time class. */
+static inline bool
+is_rt(const struct thread *t)
+{
+  return t->rt_period != 0;
+}
+
+/* Returns the CPU utilization of a real-time thread with the
+   given PERIOD and BUDGET, in units of 1/RT_UTIL_SCALE, rounded
+   up so that admission control errs on the safe side. */
+static int
+rt_util(int64_t period, int64_t budget)
+{
+  return DIV_ROUND_UP(budget * RT_UTIL_SCALE, period);
+}
+
+/* Orders real-time threads by deadline. */
+static bool
+rt_less(const struct heap_elem *a_, const struct heap_elem *b_,
+        void *aux UNUSED)
+{
+  const struct thread *a = heap_entry(a_, struct thread, rtelem);
+  const struct thread *b = heap_entry(b_, struct thread, rtelem);
+
+  return a->rt_deadline < b->rt_deadline;
+}
+
+/* Starts a new period for real-time thread T at tick NOW: the
+   period that follows the current one if NOW falls within it,
+   otherwise one beginning at NOW.  Refills T's budget. */
+static void
+rt_new_period(struct thread *t, int64_t now)
+{
+  t->rt_deadline += t->rt_period;
+  if (t->rt_deadline <= now)
+    t->rt_deadline = now + t->rt_period;
+  t->rt_remaining = t->rt_budget;
+  t->rt_throttled = false;
+}
+
+/* Starts new periods for the throttled real-time threads whose
+   deadlines have passed by tick NOW, and for the running thread
+   if it is real-time, and returns the threads to the run queue.
+   Called from the timer interrupt. */
+static void
+rt_replenish(int64_t now)
+{
+  struct thread *cur = thread_current();
+  struct list_elem *e, *next;
+
+  ASSERT(intr_context());
+
+  if (is_rt(cur) && now >= cur->rt_deadline)
+    rt_new_period(cur, now);
+
+  for (e = list_begin(&rt_throttled); e != list_end(&rt_throttled); e = next)
+  {
+    struct thread *t = list_entry(e, struct thread, elem);
+
+    next = list_next(e);
+    if (now >= t->rt_deadline)
+    {
+      list_remove(&t->elem);
+      rt_new_period(t, now);
+      ready_queue_push(t);
+      if (ready_queue_preempts(cur))
+        intr_yield_on_return();
+    }
+  }
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -612,9 +1219,13 @@ void thread_schedule_tail(struct thread *prev)
 
   /* Mark us as running. */
   cur->status = THREAD_RUNNING;
+  if (prev != NULL)
+    SCHEDTRACE(SWITCH_IN, cur->tid, cur->priority, prev->tid);
 
   /* Start new time slice. */
-  thread_ticks = 0;
+  cpu_current()->thread_ticks = 0;
+  if (thread_fair)
+    cur->exec_start = timer_now_ns();
 
 #ifdef USERPROG
   /* Activate the new address space. */
@@ -629,33 +1240,161 @@ void thread_schedule_tail(struct thread *prev)
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread)
   {
     ASSERT(prev != cur);
-    palloc_free_page(prev);
+    free_thread_page(prev);
   }
 }
 
+/* Returns a page for a new thread, from the cache if possible,
+   or a null pointer if none is available. */
+static struct thread *
+alloc_thread_page(void)
+{
+  struct cached_page *page;
+  enum intr_level old_level = spinlock_acquire(&thread_cache_lock);
+
+  page = thread_cache;
+  if (page != NULL)
+  {
+    thread_cache = page->next;
+    thread_cache_cnt--;
+  }
+  spinlock_release(&thread_cache_lock, old_level);
+
+  return page != NULL ? (struct thread *)page : palloc_get_page(0);
+}
 
-/* 唤醒正在被定时器休眠的线程 */
-void
-wakeup_thread(void)
+/* Returns the page of T, a dead thread, to the cache, or to the
+   page allocator if the cache is full.  Interrupts must be off. */
+static void
+free_thread_page(struct thread *t)
 {
-  if (list_empty(&sleep_list))
-    return; //return if sleep_list is empty
+  struct cached_page *page = (struct cached_page *)t;
+  enum intr_level old_level;
 
-  struct list_elem *e;
-  struct thread *thread;
-  e = list_begin(&sleep_list);
-  while (e != list_end(&sleep_list))
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  t->magic = 0;
+  old_level = spinlock_acquire(&thread_cache_lock);
+  if (thread_cache_cnt < THREAD_CACHE_MAX)
   {
-    thread = list_entry(e, struct thread, sleepelem);
-    if (thread->sleep_end <= timer_ticks())
-    {
-      e = list_next(e);
-      list_pop_front(&sleep_list);
-      thread_unblock(thread);
-    }
-    else
+    page->next = thread_cache;
+    thread_cache = page;
+    thread_cache_cnt++;
+    page = NULL;
+  }
+  spinlock_release(&thread_cache_lock, old_level);
+
+  if (page != NULL)
+    palloc_free_page(page);
+}
+
+
+/* Adds T, which is about to block in timer_sleep(), to the sleep
+   queue.  Returns false without adding T if its sleep_end tick
+   has already been woken up to. */
+static bool
+sleep_queue_insert(struct thread *t)
+{
+  ASSERT(intr_get_level() == INTR_OFF);
+  ASSERT(!t->sleeping);
+
+  if (t->sleep_end <= sleep_queue_tick)
+    return false;
+  heap_insert(&sleep_queue, &t->sleepelem);
+  t->sleeping = true;
+  return true;
+}
+
+/* Orders sleeping threads by wake-up tick. */
+static bool
+sleep_less(const struct heap_elem *a_, const struct heap_elem *b_,
+           void *aux UNUSED)
+{
+  const struct thread *a = heap_entry(a_, struct thread, sleepelem);
+  const struct thread *b = heap_entry(b_, struct thread, sleepelem);
+
+  return a->sleep_end < b->sleep_end;
+}
+
+/* 唤醒正在被定时器休眠的线程.
+   Wakes up every sleeping thread whose sleep_end is at or before
+   NOW, the current timer tick.  After the whole batch is woken,
+   requests a single reschedule if any of them should preempt the
+   running thread.  Called from the timer interrupt. */
+void wakeup_thread(int64_t now)
+{
+  struct thread *cur = thread_current();
+  bool woken = false;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  while (!heap_empty(&sleep_queue))
+  {
+    struct thread *t = heap_entry(heap_front(&sleep_queue), struct thread,
+                                  sleepelem);
+    if (t->sleep_end > now)
       break;
+    heap_pop_front(&sleep_queue);
+    t->sleeping = false;
+    thread_unblock(t);
+    woken = true;
+  }
+  sleep_queue_tick = now;
+
+  if (woken && (cur == cpu_current()->idle || ready_queue_preempts(cur)))
+    intr_yield_on_return();
+}
+
+/* Returns the number of ticks after NOW until the first sleeping
+   thread is due, or LIMIT if none is due within LIMIT ticks.
+   Interrupts must be off. */
+int64_t thread_next_wakeup(int64_t now, int64_t limit)
+{
+  struct list_elem *e;
+  int64_t delta;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  /* Throttled real-time threads resume at their deadlines. */
+  for (e = list_begin(&rt_throttled); e != list_end(&rt_throttled);
+       e = list_next(e))
+  {
+    int64_t deadline = list_entry(e, struct thread, elem)->rt_deadline;
+    if (deadline - now < limit)
+      limit = deadline - now > 1 ? deadline - now : 1;
+  }
+
+  if (!heap_empty(&sleep_queue))
+  {
+    delta = heap_entry(heap_front(&sleep_queue), struct thread,
+                       sleepelem)->sleep_end - now;
+    if (delta < limit)
+      return delta > 1 ? delta : 1;
   }
+  return limit;
+}
+
+/* Cancels the timer sleep of T, waking it up before its
+   sleep_end.  Returns true if T was sleeping, false if it was
+   not (e.g. because it has already been woken). */
+bool thread_sleep_cancel(struct thread *t)
+{
+  enum intr_level old_level;
+  bool was_sleeping;
+
+  ASSERT(is_thread(t));
+
+  old_level = intr_disable();
+  was_sleeping = t->sleeping;
+  if (was_sleeping)
+  {
+    heap_remove(&sleep_queue, &t->sleepelem);
+    t->sleeping = false;
+    thread_unblock(t);
+  }
+  intr_set_level(old_level);
+
+  return was_sleeping;
 }
 
 /* Schedules a new process.  At entry, interrupts must be off and
@@ -668,148 +1407,196 @@ wakeup_thread(void)
 static void
 schedule(void)
 {
-  wakeup_thread();
   struct thread *cur = running_thread();
-  struct thread *next = next_thread_to_run();
+  struct thread *next;
   struct thread *prev = NULL;
 
   ASSERT(intr_get_level() == INTR_OFF);
   ASSERT(cur->status != THREAD_RUNNING);
+
+  /* A thread that yielded was charged before it was queued. */
+  if (thread_fair && cur->status != THREAD_READY)
+    fair_account(cur);
+  next = next_thread_to_run();
   ASSERT(is_thread(next));
 
   if (cur != next)
+  {
+    uint64_t now = thread_clock();
+
+    account_state(cur, THREAD_RUNNING, now);
+    if (cur->status == THREAD_BLOCKED)
+      cur->nvcsw++;
+    else if (cur->status == THREAD_READY)
+      cur->nivcsw++;
+    account_state(next, next->status, now);
+  }
+
+  if (cur == cpu_current()->idle && next != cpu_current()->idle)
+    timer_idle_exit();
+  if (cur != next)
+  {
+    SCHEDTRACE(SWITCH_OUT, cur->tid, cur->priority, cur->status);
     prev = switch_threads(cur, next);
+  }
   thread_schedule_tail(prev);
 }
 
-/* Returns a tid to use for a new thread. */
+/* Returns a tid to use for a new thread.  Safe in any context,
+   since the counter is incremented atomically. */
 static tid_t
 allocate_tid(void)
 {
   static tid_t next_tid = 1;
-  tid_t tid;
-
-  lock_acquire(&tid_lock);
-  tid = next_tid++;
-  lock_release(&tid_lock);
 
-  return tid;
+  return __sync_fetch_and_add(&next_tid, 1);
 }
 
 void update_recent_cpu_signle()
 {
   struct thread *cur = thread_current();
-  if( cur != idle_thread) cur->recent_cpu = ADD_FP_INT(cur->recent_cpu,1);
+  if( cur != cpu_current()->idle) cur->recent_cpu = fp_add_int(cur->recent_cpu, 1);
 }
 
 //调试用函数
 int get_size(){
-  return list_size(&ready_list);
+  return ready_cnt;
 }
 
 void update_load_avg(){
-  fp tmp_load_avg = DIVIDE_FP_INT(MULTI_FP_INT(load_avg,59),60);
+  fp tmp_load_avg = fp_div_int(fp_mul_int(load_avg, 59), 60);
   size_t cur_ready;
-  if(thread_current() != idle_thread) cur_ready = list_size(&ready_list) + 1;
-  else cur_ready = list_size(&ready_list);
-  fp tmp_ready = DIVIDE_FP_INT(INT_TO_FP((int)cur_ready),60);
-  //这里tmp——load——avg类型可能不太确定
-  load_avg = ADD_FP_FP(tmp_load_avg,tmp_ready);
+  if(thread_current() != cpu_current()->idle) cur_ready = ready_cnt + 1;
+  else cur_ready = ready_cnt;
+  fp tmp_ready = fp_ratio((int)cur_ready, 60);
+  load_avg = fp_add(tmp_load_avg, tmp_ready);
 }
 
+/* Applies one per-second recent_cpu decay with coefficient
+   COEF, (2*load_avg)/(2*load_avg + 1) at that second, to T. */
+static void
+mlfqs_decay(struct thread *t, fp coef)
+{
+  t->recent_cpu = fp_add_int(fp_mul(coef, t->recent_cpu), t->nice);
+}
+
+/* Brings the recent_cpu of T, which has been blocked, up to date
+   by applying the decays of every second boundary that passed
+   since T was last updated, then recomputes its priority.
+
+   Blocked threads do not accumulate recent_cpu, so applying the
+   missed decays late gives the same result as applying them on
+   time.  Only the last MLFQS_HISTORY coefficients are kept; a
+   thread that slept longer than that gets the oldest one for the
+   remaining seconds, by which point its recent_cpu has converged
+   anyway. */
+static void
+mlfqs_catch_up(struct thread *t)
+{
+  int missed = mlfqs_epoch - t->mlfqs_epoch;
+  int epoch;
+
+  if (missed <= 0 || t == cpu_current()->idle)
+    return;
+  for (; missed > MLFQS_HISTORY; missed--)
+    mlfqs_decay(t, decay_history[(mlfqs_epoch + 1) % MLFQS_HISTORY]);
+  for (epoch = mlfqs_epoch - missed + 1; epoch <= mlfqs_epoch; epoch++)
+    mlfqs_decay(t, decay_history[epoch % MLFQS_HISTORY]);
+  t->mlfqs_epoch = mlfqs_epoch;
+  update_priority_single(t);
+}
+
+/* Once-per-second recent_cpu update.  Only threads that can run
+   are touched here: the running thread and the threads in the run
+   queues, each of which moves directly to the queue for its new
+   priority.  Blocked threads catch up in thread_unblock().
+
+   Called from timer_softirq(), either just before the timer
+   interrupt returns or in the ksoftirqd thread, with interrupts
+   turned off around the call.  The running thread is therefore
+   not necessarily the one the tick interrupted, and this function
+   must not sleep, block on a lock or allocate memory. */
 void update_recent_cpu()
 {
-  struct list_elem * e;
-  struct thread *cur;
-  fp parameter;
-  for (e = list_begin(&all_list); e != list_end(&all_list); e = list_next(e)){
-    cur = list_entry(e,struct thread,allelem);
-    if (cur != idle_thread){
-      parameter = DIVIDE_FP(MULTI_FP_INT(load_avg,2),ADD_FP_INT(MULTI_FP_INT(load_avg,2),1));
-      cur->recent_cpu = ADD_FP_INT(MULTI_FP(parameter,cur->recent_cpu),cur->nice);
-      update_priority_single(e);
-    }
-    // else return;
-  }
-  list_sort(&all_list,(list_less_func *)priority_cmp,NULL);
-  // update_priority();
-}
-
-void update_priority_single(struct list_elem * e){
-  // struct list_elem * e;
-  struct thread *cur = list_entry(e,struct thread,allelem);
-    if(cur != idle_thread){
-      fp tmp_cpu = DIVIDE_FP_INT(cur->recent_cpu,4);
-      fp tmp_priority = SUB_FP_INT(SUB_INT_FP(PRI_MAX,tmp_cpu),(2*cur->nice));
-      int tmp_pri = FP_TO_INT_ZERO(tmp_priority);
-      tmp_pri = tmp_pri > PRI_MAX? PRI_MAX:tmp_pri;
-      tmp_pri = tmp_pri < PRI_MIN? PRI_MIN:tmp_pri;
-      cur->priority = tmp_pri;
-      // if(thread_current() == cur) thread_yield();
-      // list_remove(e);
-      // list_push_ordered(&all_list, &cur->elem, cur->priority);
-    }
-    else return;
-  // }
+  struct list runnable;
+  struct thread *cur = thread_current();
+  struct thread *t;
+  fp coef = fp_decay_coef(load_avg);
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  mlfqs_epoch++;
+  decay_history[mlfqs_epoch % MLFQS_HISTORY] = coef;
+
+  if (cur != cpu_current()->idle)
+  {
+    mlfqs_decay(cur, coef);
+    cur->mlfqs_epoch = mlfqs_epoch;
+    update_priority_single(cur);
+  }
+
+  /* Drain the run queues highest priority first, then requeue,
+     so that threads keep their relative order within a level. */
+  list_init(&runnable);
+  while ((t = ready_queue_pop()) != NULL)
+    list_push_back(&runnable, &t->elem);
+  while (!list_empty(&runnable))
+  {
+    t = list_entry(list_pop_front(&runnable), struct thread, elem);
+    mlfqs_decay(t, coef);
+    t->mlfqs_epoch = mlfqs_epoch;
+    update_priority_single(t);
+    ready_queue_push(t);
+  }
+}
+
+/* Recomputes the MLFQS priority of T from its recent_cpu and
+   nice values and, if T is ready, moves it to the matching run
+   queue. */
+void update_priority_single(struct thread *t)
+{
+  if (t != cpu_current()->idle)
+  {
+    fp tmp_cpu = fp_div_int(t->recent_cpu, 4);
+    fp tmp_priority = fp_sub_int(fp_sub(fp_from_int(PRI_MAX), tmp_cpu), 2 * t->nice);
+    int tmp_pri = fp_to_int_zero(tmp_priority);
+    tmp_pri = tmp_pri > PRI_MAX ? PRI_MAX : tmp_pri;
+    tmp_pri = tmp_pri < PRI_MIN ? PRI_MIN : tmp_pri;
+    if (tmp_pri != t->priority)
+      SCHEDTRACE(PRIORITY, t->tid, tmp_pri, t->priority);
+    t->priority = tmp_pri;
+    thread_promote(t);
+  }
 }
 
-void update_priority_current(){
-  // struct list_elem * e;
+/* Recomputes the running thread's MLFQS priority. */
+void update_priority_current()
+{
   enum intr_level old_level = intr_disable();
-   
-  struct thread *cur = thread_current();
-  // int tmp_pri;
-  // fp tmp_cpu,tmp_priority;
-  // for (e = list_begin(&all_list); e != list_end(&all_list); e = list_next(e)){
-  //   cur = list_entry(e,struct thread,allelem);
-  //   if(cur != idle_thread){
-  //     tmp_cpu = DIVIDE_FP_INT(cur->recent_cpu,4);
-  //     tmp_priority = SUB_FP_INT(SUB_INT_FP(PRI_MAX,tmp_cpu),2*cur->nice);
-  //     tmp_pri = FP_TO_INT_ZERO(tmp_priority);
-  //     tmp_pri = tmp_pri > PRI_MAX? PRI_MAX:tmp_pri;
-  //     tmp_pri = tmp_pri < PRI_MIN? PRI_MIN:tmp_pri;
-  //     cur->priority = tmp_pri;
-  //     // if(thread_current() == cur) thread_yield();
-  //     // // list
-  //   }
-  //   else return;
-  // }
-  if(cur != idle_thread){
-      fp tmp_cpu = DIVIDE_FP_INT(cur->recent_cpu,4);
-      fp tmp_priority = SUB_FP_INT(SUB_INT_FP(PRI_MAX,tmp_cpu),(2*cur->nice));
-      int tmp_pri = FP_TO_INT_ZERO(tmp_priority);
-      tmp_pri = tmp_pri > PRI_MAX? PRI_MAX:tmp_pri;
-      tmp_pri = tmp_pri < PRI_MIN? PRI_MIN:tmp_pri;
-      // thread_set_priority(tmp_pri);
-      cur->priority = tmp_pri;
-      // thread_yield();
-    }
-    else return;
-     intr_set_level(old_level);
+  update_priority_single(thread_current());
+  intr_set_level(old_level);
 }
 
 /* Offset of `stack' member within `struct thread'.
    Used by switch.S, which can't figure it out on its own. */
 uint32_t thread_stack_ofs = offsetof(struct thread, stack);
 
-/* 根据优先级将线程的执行次序提前 */
-void thread_promote(struct thread *mThread)
+/* Called after T's priority changes (donation, refund, or an
+   MLFQS recomputation).  If T is ready, moves it to the run
+   queue for its new priority, which is a constant-time queue
+   move; if T is waiting on a semaphore or condition variable,
+   repositions it in that wait queue.  Interrupts must be off. */
+void thread_promote(struct thread *t)
 {
-  struct list_elem *e;
+  ASSERT(is_thread(t));
+  ASSERT(intr_get_level() == INTR_OFF);
 
-  while (&mThread->elem != list_front(&ready_list))
+  if (t->status == THREAD_READY && !thread_fair && !is_rt(t)
+      && t->ready_pri != t->priority)
   {
-    e = list_prev(&mThread->elem);
-    struct thread *thr = list_entry(e, struct thread, elem);
-    if (mThread->priority >= thr->priority)
-    {
-      //交换过程
-      thr->elem.next = mThread->elem.next;
-      mThread->elem.prev = thr->elem.prev;
-      thr->elem.prev = &mThread->elem;
-      mThread->elem.next = &thr->elem;
-    }
-    else
-      break;
+    ready_queue_remove(t);
+    ready_queue_push(t);
   }
-}
\ No newline at end of file
+  else if (t->status == THREAD_BLOCKED && t->wait_queue != NULL)
+    heap_update(t->wait_queue, &t->waitelem);
+}
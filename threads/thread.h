@@ -2,11 +2,13 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
+#include <heap.h>
 #include <list.h>
 #include <stdint.h>
 
 //TODO:增加fp库
 #include "devices/fixed-point.h"
+#include "threads/malloc.h"
 
 /* States in a thread's life cycle. */
 enum thread_status
@@ -27,10 +29,6 @@ typedef int tid_t;
 #define PRI_DEFAULT 31 /* Default priority. */
 #define PRI_MAX 63     /* Highest priority. */
 
-/* 记录所有优先级捐赠的列表 */
-struct list donation_list;
-/* 记录将要被free的记录。由于优先级归还过程中不能用free，所以先用该列表存储所有donation_log，每次lock_release后统一释放 */
-struct list donation2delete;
 //TODO:nice范围
 #define NICE_MIN -20
 #define NICE_MAX 20
@@ -85,18 +83,33 @@ struct list donation2delete;
    the `magic' member of the running thread's `struct thread' is
    set to THREAD_MAGIC.  Stack overflow will normally change this
    value, triggering the assertion. */
-/* The `elem' member has a dual purpose.  It can be an element in
-   the run queue (thread.c), or it can be an element in a
-   semaphore wait list (synch.c).  It can be used these two ways
-   only because they are mutually exclusive: only a thread in the
-   ready state is on the run queue, whereas only a thread in the
-   blocked state is on a semaphore wait list. */
+/* The `elem' member is an element in the run queue (thread.c).
+   A thread blocked on a semaphore or condition variable is
+   instead in that object's wait queue through `waitelem'
+   (synch.c), which is a priority queue; `wait_queue' points to
+   it so that a priority donation can reposition the thread. */
 struct thread
 {
    /* Owned by thread.c. */
    // TODO添加nice cputime(考虑到用load_avg计算 应该是fp浮点数)
    int nice;                   //nice level:integer max 20 min -20
    fp recent_cpu;               // recent cpu time
+   int mlfqs_epoch;             /* Last MLFQS second applied to recent_cpu. */
+   int64_t vruntime;            /* Fair scheduler: weighted runtime, in ns. */
+   int64_t exec_start;          /* Fair scheduler: when last charged. */
+   struct heap_elem fairelem;   /* Fair scheduler: run queue element. */
+   int64_t rt_period;           /* Real-time period in ticks, or 0. */
+   int64_t rt_budget;           /* Real-time CPU ticks per period. */
+   int64_t rt_deadline;         /* Tick at which the current period ends. */
+   int64_t rt_remaining;        /* Budget left in the current period. */
+   bool rt_throttled;           /* Budget exhausted until `rt_deadline'? */
+   struct heap_elem rtelem;     /* Element in the real-time run queue. */
+   uint64_t run_cycles;         /* TSC cycles spent running. */
+   uint64_t wait_cycles;        /* TSC cycles spent ready, not running. */
+   uint64_t block_cycles;       /* TSC cycles spent blocked. */
+   uint64_t state_tsc;          /* TSC when `status' last changed. */
+   unsigned nvcsw;              /* Switches away because it blocked. */
+   unsigned nivcsw;             /* Switches away while still ready. */
 
    tid_t tid;                 /* Thread identifier. */
    enum thread_status status; /* Thread state. */
@@ -104,14 +117,24 @@ struct thread
    uint8_t *stack;            /* Saved stack pointer. */
    int priority;              /* Priority. */
    int real_priority;         /* 新加入的内容，用于存储该线程释放锁后应回到的优先级 */
+   int ready_pri;             /* Run queue holding `elem' while ready. */
+   struct list held_locks;    /* Locks held, which may carry donations. */
+   struct lock *waiting_lock; /* Lock being waited for, if any. */
    int64_t sleep_end;         /* thread sleep end time*/
    int64_t sleep_begin;       /* thread sleep begin time */
    struct list_elem allelem;  /* List element for all threads list. */
 
    /* Shared between thread.c and synch.c. */
    struct list_elem elem; /* List element. */
+   struct heap_elem waitelem; /* Element in a wait queue. */
+   struct heap *wait_queue;   /* Wait queue holding `waitelem', if any. */
+   unsigned wait_seq;         /* Orders equal-priority waiters FIFO. */
 
-   struct list_elem sleepelem; /* List element for sleep threads list. */
+   struct heap_elem sleepelem; /* Element in the sleep queue. */
+   bool sleeping;              /* In the sleep queue? */
+
+   /* Owned by malloc.c. */
+   struct magazine magazines[MALLOC_CLASS_CNT]; /* Free block caches. */
 
 #ifdef USERPROG
    /* Owned by userprog/process.c. */
@@ -122,32 +145,32 @@ struct thread
    unsigned magic; /* Detects stack overflow. */
 };
 
-/* 每次发生的捐赠都会在这里被记录 */
-struct donation_log
-{
-   struct lock *mutex;
-   struct thread *donator;
-   struct thread *receiver;
-   int donator_pri;
-   int receiver_pri;
-   bool is_nest_donation;
-
-   struct list_elem don_elem;
-};
-
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* If true, use the proportional-share scheduler, which divides
+   the CPU among threads in proportion to weights derived from
+   their nice values.  Controlled by "-sched=fair". */
+extern bool thread_fair;
+
+/* If true, print every thread's run, wait and block times at
+   shutdown.  Controlled by "-threadstat". */
+extern bool thread_print_times;
+
 void thread_init(void);
 void thread_start(void);
 
 void thread_tick(void);
+void thread_tick_suppressed(int64_t);
 void thread_print_stats(void);
+void thread_print_table(void);
 
 typedef void thread_func(void *aux);
 tid_t thread_create(const char *name, int priority, thread_func *, void *);
+tid_t thread_create_rt(const char *name, int64_t period, int64_t budget,
+                       thread_func *, void *);
 
 void thread_block(bool timer_sleep);
 void thread_unblock(struct thread *);
@@ -158,6 +181,7 @@ const char *thread_name(void);
 
 void thread_exit(void) NO_RETURN;
 void thread_yield(void);
+void thread_preempt(void);
 
 /* Performs some operation on thread t, given auxiliary data AUX. */
 typedef void thread_action_func(struct thread *t, void *aux);
@@ -175,13 +199,15 @@ int thread_get_load_avg(void);
 /* 新函数声明 */
 void thread_promote(struct thread *);
 
-void wakeup_thread(void);
+void wakeup_thread(int64_t now);
+int64_t thread_next_wakeup(int64_t now, int64_t limit);
+bool thread_sleep_cancel(struct thread *);
 
 //新增的函数定义
 void update_recent_cpu_signle(void);
 void update_recent_cpu(void);
 void update_load_avg(void);
-void update_priority_single(struct list_elem * e);
+void update_priority_single(struct thread *);
 void update_priority_current(void);
 int get_size(void);
 
@@ -0,0 +1,320 @@
+#include "threads/workqueue.h"
+#include <debug.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Most worker threads a work queue may have. */
+#define WORKQUEUE_MAX_THREADS 8
+
+/* A work queue.
+
+   The members are protected by disabling interrupts, so that
+   work can be queued from interrupt handlers.  Idle workers wait
+   on `wake'.  Queuing work ups `wake' only if an idle worker has
+   not already been woken, so a burst of work queued together
+   wakes one worker, which then runs the items back to back,
+   instead of one wakeup and context switch per item. */
+struct workqueue
+{
+  char name[16];                /* Name, for the worker threads. */
+  struct list pending;          /* Queued work items, in FIFO order. */
+  struct semaphore wake;        /* Idle workers wait here. */
+  int idle_cnt;                 /* Workers waiting on `wake'. */
+  int wake_cnt;                 /* Ups of `wake' not yet consumed. */
+  struct list flushers;         /* Threads waiting for work to finish. */
+  int nthreads;                 /* Number of worker threads. */
+  struct work *running[WORKQUEUE_MAX_THREADS]; /* Work each worker runs. */
+};
+
+/* A worker thread. */
+struct worker
+{
+  struct workqueue *wq;         /* Queue to take work from. */
+  int idx;                      /* Index in WQ's `running'. */
+};
+
+/* A thread waiting in flush_work() or flush_workqueue(). */
+struct flusher
+{
+  struct list_elem elem;        /* Element in `flushers'. */
+  struct semaphore done;        /* Upped when any work item finishes. */
+};
+
+static void worker_loop(void *worker_);
+static void delayed_work_timer(struct hrtimer *);
+static bool is_running(struct workqueue *, struct work *);
+static void wait_for_completion(struct workqueue *);
+
+/* Creates a work queue named NAME, served by NTHREADS worker
+   threads of the given PRIORITY.  Returns the new work queue, or
+   a null pointer if memory or threads cannot be allocated.
+   Must not be called from an interrupt handler. */
+struct workqueue *
+workqueue_create(const char *name, int nthreads, int priority)
+{
+  struct workqueue *wq;
+  struct worker *workers;
+  int i;
+
+  ASSERT(!intr_context());
+  ASSERT(0 < nthreads && nthreads <= WORKQUEUE_MAX_THREADS);
+
+  wq = malloc(sizeof *wq);
+  workers = malloc(nthreads * sizeof *workers);
+  if (wq == NULL || workers == NULL)
+  {
+    free(wq);
+    free(workers);
+    return NULL;
+  }
+
+  strlcpy(wq->name, name, sizeof wq->name);
+  list_init(&wq->pending);
+  sema_init(&wq->wake, 0);
+  wq->idle_cnt = 0;
+  wq->wake_cnt = 0;
+  list_init(&wq->flushers);
+  wq->nthreads = nthreads;
+  for (i = 0; i < nthreads; i++)
+  {
+    wq->running[i] = NULL;
+    workers[i].wq = wq;
+    workers[i].idx = i;
+    if (thread_create(name, priority, worker_loop, &workers[i]) == TID_ERROR)
+    {
+      /* Workers already started keep serving the smaller pool;
+         the queue and their descriptors are never freed. */
+      if (i == 0)
+      {
+        free(wq);
+        free(workers);
+        return NULL;
+      }
+      wq->nthreads = i;
+      break;
+    }
+  }
+  return wq;
+}
+
+/* Initializes W to run FUNC, passing AUX. */
+void work_init(struct work *w, work_func *func, void *aux)
+{
+  ASSERT(w != NULL);
+  ASSERT(func != NULL);
+
+  w->func = func;
+  w->aux = aux;
+  w->pending = false;
+}
+
+/* Queues W on WQ, to be run by one of its workers.  Returns
+   true if W was queued, false if it was already pending.  May
+   be called from an interrupt handler. */
+bool queue_work(struct workqueue *wq, struct work *w)
+{
+  enum intr_level old_level;
+  bool queued = false;
+
+  ASSERT(wq != NULL);
+  ASSERT(w != NULL);
+
+  old_level = intr_disable();
+  if (!w->pending)
+  {
+    w->pending = true;
+    list_push_back(&wq->pending, &w->elem);
+    if (wq->idle_cnt > wq->wake_cnt)
+    {
+      wq->wake_cnt++;
+      sema_up(&wq->wake);
+    }
+    queued = true;
+  }
+  intr_set_level(old_level);
+  return queued;
+}
+
+/* Removes W from WQ if it is pending.  Returns true if W was
+   removed before it started to run, false otherwise.  W may
+   still be running when this function returns; use flush_work()
+   to wait for it.  May be called from an interrupt handler. */
+bool cancel_work(struct workqueue *wq, struct work *w)
+{
+  enum intr_level old_level;
+  bool canceled = false;
+
+  ASSERT(wq != NULL);
+  ASSERT(w != NULL);
+
+  old_level = intr_disable();
+  if (w->pending)
+  {
+    list_remove(&w->elem);
+    w->pending = false;
+    canceled = true;
+  }
+  intr_set_level(old_level);
+  return canceled;
+}
+
+/* Waits until W, queued on WQ, is neither pending nor running. */
+void flush_work(struct workqueue *wq, struct work *w)
+{
+  enum intr_level old_level;
+
+  ASSERT(!intr_context());
+
+  old_level = intr_disable();
+  while (w->pending || is_running(wq, w))
+    wait_for_completion(wq);
+  intr_set_level(old_level);
+}
+
+/* Waits until WQ has no pending or running work.  Work queued by
+   other threads in the meantime is waited for as well. */
+void flush_workqueue(struct workqueue *wq)
+{
+  enum intr_level old_level;
+
+  ASSERT(!intr_context());
+
+  old_level = intr_disable();
+  while (!list_empty(&wq->pending) || is_running(wq, NULL))
+    wait_for_completion(wq);
+  intr_set_level(old_level);
+}
+
+/* Initializes DW to run FUNC, passing AUX. */
+void delayed_work_init(struct delayed_work *dw, work_func *func, void *aux)
+{
+  work_init(&dw->work, func, aux);
+  hrtimer_init(&dw->timer, delayed_work_timer, dw);
+  dw->wq = NULL;
+}
+
+/* Queues DW on WQ once TICKS timer ticks have passed, or at once
+   if TICKS is not positive.  Returns true if DW was queued or its
+   timer started, false if it was already pending.  May be called
+   from an interrupt handler. */
+bool queue_delayed_work(struct workqueue *wq, struct delayed_work *dw,
+                        int64_t ticks)
+{
+  enum intr_level old_level;
+  bool queued = false;
+
+  ASSERT(wq != NULL);
+  ASSERT(dw != NULL);
+
+  if (ticks <= 0)
+  {
+    dw->wq = wq;
+    return queue_work(wq, &dw->work);
+  }
+
+  old_level = intr_disable();
+  if (!dw->timer.pending && !dw->work.pending)
+  {
+    dw->wq = wq;
+    hrtimer_start(&dw->timer,
+                  timer_now_ns() + ticks * (1000000000 / TIMER_FREQ));
+    queued = true;
+  }
+  intr_set_level(old_level);
+  return queued;
+}
+
+/* Cancels DW, whether it is still waiting for its delay or
+   already queued.  Returns true if it was canceled before it
+   started to run.  May be called from an interrupt handler. */
+bool cancel_delayed_work(struct delayed_work *dw)
+{
+  ASSERT(dw != NULL);
+
+  if (hrtimer_cancel(&dw->timer))
+    return true;
+  return dw->wq != NULL && cancel_work(dw->wq, &dw->work);
+}
+
+/* Queues the delayed work whose timer has expired.  Runs in the
+   timer interrupt. */
+static void
+delayed_work_timer(struct hrtimer *timer)
+{
+  struct delayed_work *dw = timer->aux;
+
+  queue_work(dw->wq, &dw->work);
+}
+
+/* A worker thread: runs work items from its queue, oldest first,
+   waiting on the queue's semaphore while there are none. */
+static void
+worker_loop(void *worker_)
+{
+  struct worker *worker = worker_;
+  struct workqueue *wq = worker->wq;
+
+  intr_disable();
+  for (;;)
+  {
+    struct work *w;
+
+    while (list_empty(&wq->pending))
+    {
+      wq->idle_cnt++;
+      sema_down(&wq->wake);
+      wq->idle_cnt--;
+      wq->wake_cnt--;
+    }
+
+    w = list_entry(list_pop_front(&wq->pending), struct work, elem);
+    w->pending = false;
+    wq->running[worker->idx] = w;
+    intr_enable();
+
+    /* W may be freed or requeued by FUNC, so it is not touched
+       again after this call. */
+    w->func(w->aux);
+
+    intr_disable();
+    wq->running[worker->idx] = NULL;
+    while (!list_empty(&wq->flushers))
+    {
+      struct flusher *f = list_entry(list_pop_front(&wq->flushers),
+                                     struct flusher, elem);
+      sema_up(&f->done);
+    }
+  }
+}
+
+/* Returns true if one of WQ's workers is running W, or any work
+   at all if W is a null pointer.  Interrupts must be off. */
+static bool
+is_running(struct workqueue *wq, struct work *w)
+{
+  int i;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  for (i = 0; i < wq->nthreads; i++)
+    if (w != NULL ? wq->running[i] == w : wq->running[i] != NULL)
+      return true;
+  return false;
+}
+
+/* Waits until some work item on WQ finishes.  Interrupts must be
+   off. */
+static void
+wait_for_completion(struct workqueue *wq)
+{
+  struct flusher f;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  sema_init(&f.done, 0);
+  list_push_back(&wq->flushers, &f.elem);
+  sema_down(&f.done);
+}
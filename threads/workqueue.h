@@ -0,0 +1,53 @@
+#ifndef THREADS_WORKQUEUE_H
+#define THREADS_WORKQUEUE_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "devices/timer.h"
+
+/* Work queues.
+
+   A work queue runs deferred work items on a fixed pool of
+   worker threads, so that an interrupt handler or a latency
+   sensitive path can hand off expensive work without creating a
+   thread for it.  Work may be queued from any context, including
+   interrupt handlers.  A work item is queued at most once at a
+   time: queuing it again while it is pending has no effect. */
+
+struct workqueue;
+
+typedef void work_func(void *aux);
+
+/* A work item. */
+struct work
+{
+  struct list_elem elem;  /* Element in the queue's pending list. */
+  work_func *func;        /* Function to run. */
+  void *aux;              /* Auxiliary data for FUNC. */
+  bool pending;           /* Queued and not yet started? */
+};
+
+/* A work item queued after a delay. */
+struct delayed_work
+{
+  struct work work;       /* The work item itself. */
+  struct hrtimer timer;   /* Queues `work' when it expires. */
+  struct workqueue *wq;   /* Queue to put `work' on. */
+};
+
+struct workqueue *workqueue_create(const char *name, int nthreads,
+                                   int priority);
+
+void work_init(struct work *, work_func *, void *aux);
+bool queue_work(struct workqueue *, struct work *);
+bool cancel_work(struct workqueue *, struct work *);
+void flush_work(struct workqueue *, struct work *);
+void flush_workqueue(struct workqueue *);
+
+void delayed_work_init(struct delayed_work *, work_func *, void *aux);
+bool queue_delayed_work(struct workqueue *, struct delayed_work *,
+                        int64_t ticks);
+bool cancel_delayed_work(struct delayed_work *);
+
+#endif /* threads/workqueue.h */
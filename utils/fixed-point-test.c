@@ -0,0 +1,210 @@
+/* Host-side unit test and benchmark for devices/fixed-point.h.
+
+   Checks every operation against double-precision arithmetic,
+   then runs the MLFQS recent_cpu recurrence for a CPU-bound
+   thread and compares it with the exact result.  Finally times
+   the once-per-second recent_cpu update for many threads, with
+   the decay coefficient recomputed for each thread (as the
+   scheduler used to do) and with it computed once per second.
+
+   Build with -DFP_PRECISE to test the 64-bit representation.
+   Exits with status 0 if all checks pass. */
+
+#define _GNU_SOURCE 1
+#include <math.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../devices/fixed-point.h"
+
+static int failures;
+
+/* Returns the value of X as a double. */
+static double
+fp_to_double (fp x)
+{
+  return (double) x.raw / FP_ONE;
+}
+
+/* Checks that ACTUAL is within TOLERANCE of EXPECTED. */
+static void
+check_near (const char *what, double actual, double expected,
+            double tolerance)
+{
+  if (fabs (actual - expected) > tolerance)
+    {
+      printf ("FAIL: %s: got %f, expected %f\n", what, actual, expected);
+      failures++;
+    }
+}
+
+/* Checks that ACTUAL equals EXPECTED. */
+static void
+check_int (const char *what, int actual, int expected)
+{
+  if (actual != expected)
+    {
+      printf ("FAIL: %s: got %d, expected %d\n", what, actual, expected);
+      failures++;
+    }
+}
+
+/* Tests the arithmetic operations on a grid of operands. */
+static void
+test_operations (void)
+{
+  const double eps = 2.0 / FP_ONE;
+  int a, b;
+
+  for (a = -300; a <= 300; a += 7)
+    for (b = -50; b <= 50; b += 3)
+      {
+        fp x = fp_ratio (a, 4);
+        fp y = fp_ratio (b, 3);
+        double dx = a / 4.0, dy = b / 3.0;
+
+        check_near ("fp_ratio", fp_to_double (x), dx, eps);
+        check_near ("fp_add", fp_to_double (fp_add (x, y)), dx + dy, eps);
+        check_near ("fp_sub", fp_to_double (fp_sub (x, y)), dx - dy, eps);
+        check_near ("fp_add_int", fp_to_double (fp_add_int (x, b)),
+                    dx + b, eps);
+        check_near ("fp_sub_int", fp_to_double (fp_sub_int (x, b)),
+                    dx - b, eps);
+        check_near ("fp_mul", fp_to_double (fp_mul (x, y)), dx * dy,
+                    eps * (1 + fabs (dx) + fabs (dy)));
+        check_near ("fp_mul_int", fp_to_double (fp_mul_int (x, b)), dx * b,
+                    eps * (1 + abs (b)));
+        if (b != 0)
+          {
+            check_near ("fp_div", fp_to_double (fp_div (x, y)), dx / dy,
+                        eps * (1 + fabs (dx / dy)) * 4);
+            check_near ("fp_div_int", fp_to_double (fp_div_int (x, b)),
+                        dx / b, eps);
+          }
+        check_int ("fp_to_int_zero", fp_to_int_zero (x), (int) trunc (dx));
+        check_int ("fp_to_int_nearest", fp_to_int_nearest (x),
+                   (int) lround (dx));
+      }
+}
+
+/* Tests rounding and conversions at the edges. */
+static void
+test_rounding (void)
+{
+  check_int ("round 2.5", fp_to_int_nearest (fp_ratio (5, 2)), 3);
+  check_int ("round -2.5", fp_to_int_nearest (fp_ratio (-5, 2)), -3);
+  check_int ("round 1.49", fp_to_int_nearest (fp_ratio (149, 100)), 1);
+  check_int ("trunc -1.5", fp_to_int_zero (fp_ratio (-3, 2)), -1);
+  check_int ("from_int", fp_to_int_zero (fp_from_int (-20)), -20);
+
+  /* 100 * recent_cpu must not overflow even near the top of the
+     32-bit range. */
+  check_int ("round_scaled large", fp_round_scaled (fp_from_int (30000), 100),
+             3000000);
+  check_int ("round_scaled small", fp_round_scaled (fp_ratio (1, 60), 100), 2);
+  check_int ("round_scaled negative",
+             fp_round_scaled (fp_ratio (-1, 60), 100), -2);
+}
+
+/* Runs the recent_cpu recurrence for a thread that is always
+   running with a given load average and nice value, for SECONDS
+   seconds, and compares the result with exact arithmetic. */
+static void
+test_recent_cpu (double load, int nice, int seconds)
+{
+  fp load_avg = fp_ratio ((int) (load * 1000), 1000);
+  fp recent_cpu = fp_from_int (0);
+  double exact_load = fp_to_double (load_avg);
+  double exact = 0;
+  char what[64];
+  int s, t;
+
+  for (s = 0; s < seconds; s++)
+    {
+      fp coef = fp_decay_coef (load_avg);
+      double exact_coef = 2 * exact_load / (2 * exact_load + 1);
+
+      for (t = 0; t < 100; t++)
+        {
+          recent_cpu = fp_add_int (recent_cpu, 1);
+          exact += 1;
+        }
+      recent_cpu = fp_add_int (fp_mul (coef, recent_cpu), nice);
+      exact = exact_coef * exact + nice;
+    }
+  snprintf (what, sizeof what, "recent_cpu (load %.1f, nice %d)", load, nice);
+  check_near (what, fp_to_double (recent_cpu), exact, 0.01 * fabs (exact) + 1);
+}
+
+/* Returns the current time in nanoseconds. */
+static double
+now_ns (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+#define BENCH_THREADS 1000
+#define BENCH_SECONDS 2000
+
+/* Times the per-second recent_cpu update for BENCH_THREADS
+   threads, recomputing the decay coefficient per thread or once
+   per second. */
+static void
+benchmark (void)
+{
+  static fp recent_cpu[BENCH_THREADS];
+  static int nice[BENCH_THREADS];
+  volatile fp load_avg = fp_ratio (3, 2);
+  double start, per_thread, once;
+  int s, t;
+
+  for (t = 0; t < BENCH_THREADS; t++)
+    nice[t] = t % 41 - 20;
+
+  start = now_ns ();
+  for (s = 0; s < BENCH_SECONDS; s++)
+    for (t = 0; t < BENCH_THREADS; t++)
+      {
+        fp coef = fp_decay_coef (load_avg);
+        recent_cpu[t] = fp_add_int (fp_mul (coef, recent_cpu[t]), nice[t]);
+      }
+  per_thread = (now_ns () - start) / ((double) BENCH_SECONDS * BENCH_THREADS);
+
+  start = now_ns ();
+  for (s = 0; s < BENCH_SECONDS; s++)
+    {
+      fp coef = fp_decay_coef (load_avg);
+      for (t = 0; t < BENCH_THREADS; t++)
+        recent_cpu[t] = fp_add_int (fp_mul (coef, recent_cpu[t]), nice[t]);
+    }
+  once = (now_ns () - start) / ((double) BENCH_SECONDS * BENCH_THREADS);
+
+  printf ("recent_cpu update, coefficient per thread: %6.2f ns/thread\n",
+          per_thread);
+  printf ("recent_cpu update, coefficient per second: %6.2f ns/thread\n",
+          once);
+}
+
+int
+main (int argc, char *argv[])
+{
+  bool bench = argc > 1 && !strcmp (argv[1], "-b");
+
+  printf ("fixed-point: %d-bit representation\n", (int) sizeof (fp_raw) * 8);
+  test_operations ();
+  test_rounding ();
+  test_recent_cpu (0.5, 0, 60);
+  test_recent_cpu (1.0, 20, 120);
+  test_recent_cpu (4.0, -20, 120);
+  if (sizeof (fp_raw) == 8)
+    test_recent_cpu (30.0, 0, 600);
+  if (bench)
+    benchmark ();
+
+  printf ("%s\n", failures ? "FAILED" : "PASSED");
+  return failures != 0;
+}